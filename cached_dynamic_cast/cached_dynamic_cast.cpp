@@ -1,7 +1,1111 @@
 #include "cached_dynamic_cast.hpp"
 
+#if CACHED_DYNAMIC_CAST_USDT_PROBES
+// with semaphores, so that the tools find them in the section below; only ever built into the library
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define CACHED_DYNAMIC_CAST_DETAIL_PROBE(name, ...) STAP_PROBEV(cached_dynamic_cast, name, __VA_ARGS__)
+#else
+#define CACHED_DYNAMIC_CAST_DETAIL_PROBE(name, ...) static_cast<void>(0)
+#endif
+
+#include "cached_dynamic_cast_backends.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#if defined(__GXX_ABI_VERSION) && __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+#if __has_include(<link.h>)
+#include <link.h>
+#define CACHED_DYNAMIC_CAST_DETAIL_HAS_DL_ITERATE_PHDR 1
+#else
+#define CACHED_DYNAMIC_CAST_DETAIL_HAS_DL_ITERATE_PHDR 0
+#endif
+
+#if CACHED_DYNAMIC_CAST_USDT_PROBES
+// in the section where the tools look for the semaphores of the probes, see <sys/sdt.h>
+extern "C"
+{
+  volatile unsigned short cached_dynamic_cast_slow_path_entry_semaphore __attribute__((section(".probes"))) = 0;
+  volatile unsigned short cached_dynamic_cast_slow_path_exit_semaphore __attribute__((section(".probes"))) = 0;
+  volatile unsigned short cached_dynamic_cast_writer_lock_semaphore __attribute__((section(".probes"))) = 0;
+  volatile unsigned short cached_dynamic_cast_insert_semaphore __attribute__((section(".probes"))) = 0;
+  volatile unsigned short cached_dynamic_cast_reset_semaphore __attribute__((section(".probes"))) = 0;
+}
+#endif
+
+namespace detail::cached_dynamic_cast_detail
+{
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::atomic<epoch_type> last_cache_epoch{ 0 };
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::atomic<std::size_t> next_dense_cast_id{ 0 };
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE epoch_type next_cache_epoch() noexcept
+  {
+    epoch_type epoch = last_cache_epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+    while (epoch == 0)
+      epoch = last_cache_epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+    return epoch;
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t allocate_dense_cast_id() noexcept
+  {
+    return next_dense_cast_id.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // the arguments are unused without `CACHED_DYNAMIC_CAST_USDT_PROBES`
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void fire_slow_path_entry_probe([[maybe_unused]] const std::type_info& destination_type,
+                                                                    [[maybe_unused]] const std::type_info& dynamic_type) noexcept
+  {
+    CACHED_DYNAMIC_CAST_DETAIL_PROBE(slow_path_entry, destination_type.name(), dynamic_type.name());
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void fire_slow_path_exit_probe([[maybe_unused]] const std::type_info& destination_type,
+                                                                   [[maybe_unused]] const std::type_info& dynamic_type,
+                                                                   [[maybe_unused]] const std::uint64_t dynamic_cast_nanoseconds,
+                                                                   [[maybe_unused]] const bool has_succeeded) noexcept
+  {
+    CACHED_DYNAMIC_CAST_DETAIL_PROBE(slow_path_exit, destination_type.name(), dynamic_type.name(),
+                                     dynamic_cast_nanoseconds, static_cast<int>(has_succeeded));
+  }
+
+  struct type_matrix::growth_state
+  {
+    std::mutex mutex;
+    // the current ones last, the ones they replaced kept for the readers which may still be using them
+    std::vector<std::unique_ptr<dynamic_id_table>> dynamic_id_tables;
+    std::vector<std::unique_ptr<row_directory>> row_directories;
+    std::vector<std::unique_ptr<row>> rows;
+    std::vector<std::unique_ptr<block>> blocks;
+    std::size_t dynamic_key_count = 0;
+    std::size_t max_block_count = 0; // 0 means unbounded
+    std::size_t bytes_used = 0;
+  };
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE type_matrix::row::row(const std::size_t block_count)
+    : block_count{ block_count }
+    , blocks{ std::make_unique<std::atomic<block*>[]>(block_count) }
+  {
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE type_matrix::row_directory::row_directory(const std::size_t size)
+    : size{ size }
+    , rows{ std::make_unique<std::atomic<row*>[]>(size) }
+  {
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE type_matrix::dynamic_id_table::dynamic_id_table(const std::size_t size)
+    : mask{ size - 1 }
+    , slots{ std::make_unique<dynamic_id_slot[]>(size) }
+  {
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE type_matrix::type_matrix()
+    : growth{ std::make_unique<growth_state>() }
+  {
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE type_matrix::~type_matrix() = default;
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void type_matrix::store(const void* const dynamic_key, const std::size_t column,
+                                                            const epoch_type epoch, const offset_type offset)
+  {
+    // a store racing with a reset may tag a cell with the old epoch, which only hides it until the next store
+    const cell_type value = (static_cast<cell_type>(epoch) << 32) | static_cast<std::uint32_t>(offset);
+    if (std::atomic<cell_type>* const cell = find_cell(dynamic_key, column); cell != nullptr)
+    {
+      cell->store(value, std::memory_order_relaxed);
+      return;
+    }
+    if (is_full.load(std::memory_order_relaxed))
+      return;
+    std::lock_guard lock{ growth->mutex };
+    if (std::atomic<cell_type>* const cell = allocate_cell_locked(dynamic_key, column); cell != nullptr)
+      cell->store(value, std::memory_order_relaxed);
+  }
+
+  // the cell of `column` in the row of `dynamic_key`, allocating whatever is missing, null if the bound is reached
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::atomic<type_matrix::cell_type>* type_matrix::allocate_cell_locked(const void* const dynamic_key,
+                                                                                                          const std::size_t column)
+  {
+    if (std::atomic<cell_type>* const cell = find_cell(dynamic_key, column); cell != nullptr)
+      return cell; // stored by another thread while this one was waiting for the lock
+    if (growth->max_block_count != 0 && growth->blocks.size() >= growth->max_block_count)
+    {
+      is_full.store(true, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    std::size_t dynamic_id = find_dynamic_id(dynamic_key);
+    if (dynamic_id == missing_dynamic_id)
+      dynamic_id = allocate_dynamic_id_locked(dynamic_key);
+    row_directory& directory = *growth->row_directories.back();
+    row* cells = directory.rows[dynamic_id].load(std::memory_order_relaxed);
+    if (column / block_size >= cells->block_count)
+    {
+      auto grown = std::make_unique<row>(std::max(column / block_size + 1, cells->block_count * 2));
+      for (std::size_t index = 0; index < cells->block_count; ++index)
+        grown->blocks[index].store(cells->blocks[index].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      growth->bytes_used += grown->block_count * sizeof(std::atomic<block*>);
+      cells = grown.get();
+      growth->rows.push_back(std::move(grown));
+      directory.rows[dynamic_id].store(cells, std::memory_order_release);
+    }
+
+    auto allocated = std::make_unique<block>();
+    block* const cell_block = allocated.get();
+    growth->blocks.push_back(std::move(allocated));
+    growth->bytes_used += sizeof(block);
+    if (growth->max_block_count != 0 && growth->blocks.size() >= growth->max_block_count)
+      is_full.store(true, std::memory_order_relaxed);
+    cells->blocks[column / block_size].store(cell_block, std::memory_order_release);
+    return &cell_block->cells[column % block_size];
+  }
+
+  // numbers `dynamic_key` and gives it an empty row, which is published before the number is
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t type_matrix::allocate_dynamic_id_locked(const void* const dynamic_key)
+  {
+    const std::size_t dynamic_id = growth->dynamic_key_count++;
+
+    if (growth->row_directories.empty() || dynamic_id >= growth->row_directories.back()->size)
+    {
+      const std::size_t old_size = growth->row_directories.empty() ? 0 : growth->row_directories.back()->size;
+      auto grown = std::make_unique<row_directory>(std::max<std::size_t>(old_size * 2, 32));
+      for (std::size_t index = 0; index < old_size; ++index)
+      {
+        grown->rows[index].store(growth->row_directories.back()->rows[index].load(std::memory_order_relaxed),
+                                 std::memory_order_relaxed);
+      }
+      growth->bytes_used += grown->size * sizeof(std::atomic<row*>);
+      current_directory.store(grown.get(), std::memory_order_release);
+      growth->row_directories.push_back(std::move(grown));
+    }
+    auto cells = std::make_unique<row>(4);
+    growth->bytes_used += cells->block_count * sizeof(std::atomic<block*>);
+    growth->row_directories.back()->rows[dynamic_id].store(cells.get(), std::memory_order_release);
+    growth->rows.push_back(std::move(cells));
+
+    const auto slot_for = [](const dynamic_id_table& table, const void* const key) -> dynamic_id_slot&
+    {
+      std::size_t index = hash(key) & table.mask;
+      while (table.slots[index].dynamic_key.load(std::memory_order_relaxed) != nullptr)
+        index = (index + 1) & table.mask;
+      return table.slots[index];
+    };
+    if (growth->dynamic_id_tables.empty() || (dynamic_id + 1) * 2 > growth->dynamic_id_tables.back()->mask + 1)
+    {
+      const dynamic_id_table* const old_table = growth->dynamic_id_tables.empty() ? nullptr : growth->dynamic_id_tables.back().get();
+      auto grown = std::make_unique<dynamic_id_table>((old_table == nullptr) ? 64 : (old_table->mask + 1) * 2);
+      for (std::size_t index = 0; old_table != nullptr && index <= old_table->mask; ++index)
+      {
+        const void* const key = old_table->slots[index].dynamic_key.load(std::memory_order_relaxed);
+        if (key == nullptr)
+          continue;
+        dynamic_id_slot& new_slot = slot_for(*grown, key);
+        new_slot.dynamic_id.store(old_table->slots[index].dynamic_id.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        new_slot.dynamic_key.store(key, std::memory_order_relaxed);
+      }
+      growth->bytes_used += (grown->mask + 1) * sizeof(dynamic_id_slot);
+      current_ids.store(grown.get(), std::memory_order_release);
+      growth->dynamic_id_tables.push_back(std::move(grown));
+    }
+    dynamic_id_slot& new_slot = slot_for(*growth->dynamic_id_tables.back(), dynamic_key);
+    new_slot.dynamic_id.store(dynamic_id, std::memory_order_relaxed);
+    new_slot.dynamic_key.store(dynamic_key, std::memory_order_release);
+    return dynamic_id;
+  }
+
+  // the blocks already allocated are kept when the bound shrinks, the casts keep using them
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void type_matrix::set_max_size(const std::size_t max_entry_count)
+  {
+    std::lock_guard lock{ growth->mutex };
+    growth->max_block_count = (max_entry_count + block_size - 1) / block_size;
+    is_full.store(growth->max_block_count != 0 && growth->blocks.size() >= growth->max_block_count, std::memory_order_relaxed);
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t type_matrix::bytes_used() const
+  {
+    std::lock_guard lock{ growth->mutex };
+    return growth->bytes_used;
+  }
+
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE bool is_in_ranges(const void* const address, const std::vector<address_range>& ranges) noexcept
+  {
+    const auto value = reinterpret_cast<std::uintptr_t>(address);
+    return std::any_of(ranges.begin(), ranges.end(), [value](const address_range& range)
+    {
+      return value >= reinterpret_cast<std::uintptr_t>(range.begin) && value < reinterpret_cast<std::uintptr_t>(range.end);
+    });
+  }
+
+  // the loaded segments of the module containing `address_in_module`, none if there is no such module
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE std::vector<address_range> module_address_ranges(const void* const address_in_module)
+  {
+    std::vector<address_range> ranges;
+#if CACHED_DYNAMIC_CAST_DETAIL_HAS_DL_ITERATE_PHDR
+    // the callback only remembers the module, nothing may throw through `dl_iterate_phdr()`
+    struct module_search
+    {
+      std::uintptr_t address;
+      dl_phdr_info module;
+      bool is_found;
+    } search{ reinterpret_cast<std::uintptr_t>(address_in_module), {}, false };
+
+    dl_iterate_phdr([](dl_phdr_info* const info, std::size_t, void* const data) noexcept
+    {
+      module_search& search = *static_cast<module_search*>(data);
+      for (ElfW(Half) index = 0; index < info->dlpi_phnum; ++index)
+      {
+        const ElfW(Phdr)& header = info->dlpi_phdr[index];
+        const std::uintptr_t begin = info->dlpi_addr + header.p_vaddr;
+        if (header.p_type == PT_LOAD && search.address >= begin && search.address < begin + header.p_memsz)
+        {
+          search.module = *info;
+          search.is_found = true;
+          return 1;
+        }
+      }
+      return 0;
+    }, &search);
+
+    if (search.is_found)
+    {
+      for (ElfW(Half) index = 0; index < search.module.dlpi_phnum; ++index)
+      {
+        const ElfW(Phdr)& header = search.module.dlpi_phdr[index];
+        if (header.p_type != PT_LOAD)
+          continue;
+        const std::uintptr_t begin = search.module.dlpi_addr + header.p_vaddr;
+        ranges.push_back(address_range{ reinterpret_cast<const void*>(begin), reinterpret_cast<const void*>(begin + header.p_memsz) });
+      }
+    }
+#else
+    static_cast<void>(address_in_module);
+#endif
+    return ranges;
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void erase_pair_statistics_in_ranges(const std::vector<address_range>& ranges); // below
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t erase_registered_classes_in_ranges(const std::vector<address_range>& ranges); // below
+} // namespace detail::cached_dynamic_cast_detail
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE cast_cache::cast_cache(const std::size_t capacity,
+                                                         std::pmr::memory_resource* const upstream_memory)
+  : epoch{ detail::cached_dynamic_cast_detail::next_cache_epoch() }
+  , storage{ std::make_unique<detail::cached_dynamic_cast_detail::cast_cache_storage>(upstream_memory) }
+{
+  if (capacity != detail::cached_dynamic_cast_detail::global_cache_capacity)
+    storage->set_capacity(capacity);
+  if constexpr (detail::cached_dynamic_cast_detail::type_matrix_enabled)
+    matrix.set_max_size(capacity);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE cast_cache::~cast_cache() = default;
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void cast_cache::reset()
+{
+  std::lock_guard reset_lock{ storage->reset_mutex };
+  storage->clear(); // the cells of the matrix are tagged with the old epoch, they need no clearing
+
+  // invalidate thread-local entries lazily: they are checked against the current epoch on every lookup
+  const epoch_type new_epoch = detail::cached_dynamic_cast_detail::next_cache_epoch();
+  epoch.store(new_epoch, std::memory_order_release);
+  if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(reset))
+    CACHED_DYNAMIC_CAST_DETAIL_PROBE(reset, static_cast<const void*>(this), new_epoch);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE cached_dynamic_cast_global_cache_usage cast_cache::usage() const
+{
+  cached_dynamic_cast_global_cache_usage result = storage->usage();
+  result.bytes_used += matrix.bytes_used();
+  return result;
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void cast_cache::set_capacity(const std::size_t capacity)
+{
+  storage->set_capacity(capacity);
+  if constexpr (detail::cached_dynamic_cast_detail::type_matrix_enabled)
+    matrix.set_max_size(capacity);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void cast_cache::compact()
+{
+  storage->compact(); // the matrix keeps its blocks for the next entries, it has nothing left over
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t cast_cache::erase_address_range(const void* const begin, const void* const end)
+{
+  return erase_address_ranges({ detail::cached_dynamic_cast_detail::address_range{ begin, end } });
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t cast_cache::erase_module(const void* const address_in_module)
+{
+  using namespace detail::cached_dynamic_cast_detail;
+  const std::vector<address_range> ranges = module_address_ranges(address_in_module);
+  if (ranges.empty())
+    return 0;
+  erase_pair_statistics_in_ranges(ranges);
+  erase_registered_classes_in_ranges(ranges);
+  return erase_address_ranges(ranges);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t cast_cache::erase_address_ranges(const std::vector<detail::cached_dynamic_cast_detail::address_range>& ranges)
+{
+  using detail::cached_dynamic_cast_detail::is_in_ranges;
+  std::lock_guard reset_lock{ storage->reset_mutex };
+  const std::size_t erased_count = storage->erase_if([&ranges](const cache_key& key)
+  {
+    return is_in_ranges(key.destination_type, ranges) || is_in_ranges(key.source_dynamic_key, ranges)
+        || is_in_ranges(key.source_static_type, ranges);
+  });
+
+  // the copies in the thread-local and per-call-site caches and in the matrix cannot be told apart, so all of
+  // them go with the new epoch
+  epoch.store(detail::cached_dynamic_cast_detail::next_cache_epoch(), std::memory_order_release);
+  return erased_count;
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE cast_cache::offset_type cast_cache::find_through_matrix(const cache_key& key, const std::size_t column,
+                                                                                         const epoch_type epoch)
+{
+  using detail::cached_dynamic_cast_detail::missing_entry_offset;
+  offset_type offset = matrix.find(key.source_dynamic_key, column, epoch);
+  if (offset != missing_entry_offset)
+    return offset;
+  offset = find(key);
+  if (offset != missing_entry_offset)
+    matrix.store(key.source_dynamic_key, column, epoch, offset);
+  return offset;
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE cast_cache::offset_type cast_cache::find(const cache_key& key) const
+{
+  return storage->find(key);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void cast_cache::store(const cache_key& key, const offset_type offset)
+{
+  storage->store(key, offset);
+  if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(insert))
+    CACHED_DYNAMIC_CAST_DETAIL_PROBE(insert, key.destination_type->name(), key.source_dynamic_key, offset,
+                                     static_cast<const void*>(this));
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void cast_cache::store_many(const cache_entry* const entries, const std::size_t count)
+{
+  storage->store_many(entries, count);
+  if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(insert))
+    for (const cache_entry* entry = entries; entry != entries + count; ++entry)
+      CACHED_DYNAMIC_CAST_DETAIL_PROBE(insert, entry->key.destination_type->name(), entry->key.source_dynamic_key,
+                                       entry->offset, static_cast<const void*>(this));
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::vector<cast_cache::cache_entry> cast_cache::copy_entries() const
+{
+  std::vector<cache_entry> entries;
+  storage->copy_entries(entries);
+  return entries;
+}
+
 namespace detail::cached_dynamic_cast_detail
 {
-  global_cache_type global_cache{};
-  std::shared_mutex global_cache_mutex{};
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE cast_cache default_cast_cache_instance{};
+
+  // filled during static initialization, hence a function-local static
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::vector<prewarm_function>& registered_prewarms()
+  {
+    static std::vector<prewarm_function> prewarms;
+    return prewarms;
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE bool register_prewarm(const prewarm_function prewarm)
+  {
+    registered_prewarms().push_back(prewarm);
+    return true;
+  }
+
+  struct call_site_registry
+  {
+    static std::mutex& mutex()
+    {
+      static std::mutex registry_mutex;
+      return registry_mutex;
+    }
+
+    static call_site_cache_base*& head()
+    {
+      static call_site_cache_base* registry_head = nullptr;
+      return registry_head;
+    }
+
+    static void add(call_site_cache_base& call_site)
+    {
+      std::lock_guard lock{ mutex() };
+      call_site.next_in_registry = head();
+      if (head() != nullptr)
+        head()->previous_in_registry = &call_site;
+      head() = &call_site;
+    }
+
+    static void remove(call_site_cache_base& call_site)
+    {
+      std::lock_guard lock{ mutex() };
+      if (call_site.previous_in_registry != nullptr)
+        call_site.previous_in_registry->next_in_registry = call_site.next_in_registry;
+      else
+        head() = call_site.next_in_registry;
+      if (call_site.next_in_registry != nullptr)
+        call_site.next_in_registry->previous_in_registry = call_site.previous_in_registry;
+    }
+
+    static std::vector<cached_dynamic_cast_call_site_statistics> collect()
+    {
+      std::vector<cached_dynamic_cast_call_site_statistics> result;
+      std::lock_guard lock{ mutex() };
+      for (const call_site_cache_base* call_site = head(); call_site != nullptr; call_site = call_site->next_in_registry)
+      {
+        result.push_back(cached_dynamic_cast_call_site_statistics{
+          call_site->file,
+          call_site->line,
+          call_site->entry_count.load(std::memory_order_relaxed),
+          call_site->is_megamorphic.load(std::memory_order_relaxed),
+          call_site->monomorphic_lookups.load(std::memory_order_relaxed),
+          call_site->polymorphic_lookups.load(std::memory_order_relaxed),
+          call_site->megamorphic_lookups.load(std::memory_order_relaxed),
+          call_site->misses.load(std::memory_order_relaxed) });
+      }
+      return result;
+    }
+  };
+
+  // classes registered by `CACHED_DYNAMIC_CAST_REGISTER_CLASS`, keyed by the address of their `type_info`
+  // (a `type_info` duplicated by another module merely is not found, the cast then takes the usual path):
+  // open addressing, the classes of an unloaded module are replaced by a tombstone that lookups pass over
+  // without reading the module's memory; a grown table is published atomically and the old ones are kept
+  // around, so lookups take no lock
+  class registered_class_registry
+  {
+  public:
+    static registered_class_registry& instance()
+    {
+      static registered_class_registry registry;
+      return registry;
+    }
+
+    void add(const registered_class_info& info)
+    {
+      std::lock_guard lock{ mutex };
+      if (tables.empty() || (used_slot_count + 1) * 2 > tables.back()->size())
+      {
+        // the tombstones are left behind, so the table only grows if the classes themselves need it
+        std::size_t class_count = 0;
+        if (!tables.empty())
+          for (const std::atomic<const registered_class_info*>& slot : *tables.back())
+            if (const registered_class_info* const registered = slot.load(std::memory_order_relaxed);
+                registered != nullptr && registered != &erased_class)
+              ++class_count;
+        std::size_t new_size = tables.empty() ? 64 : tables.back()->size();
+        if ((class_count + 1) * 2 > new_size)
+          new_size *= 2;
+
+        auto new_table = std::make_unique<table>(new_size);
+        if (!tables.empty())
+          for (const std::atomic<const registered_class_info*>& slot : *tables.back())
+            if (const registered_class_info* const registered = slot.load(std::memory_order_relaxed);
+                registered != nullptr && registered != &erased_class)
+              slot_for(*new_table, *registered->type).store(registered, std::memory_order_relaxed);
+        current.store(new_table.get(), std::memory_order_release);
+        tables.push_back(std::move(new_table));
+        used_slot_count = class_count;
+      }
+
+      std::atomic<const registered_class_info*>& slot = slot_for(*tables.back(), *info.type);
+      if (slot.load(std::memory_order_relaxed) == nullptr)
+        ++used_slot_count;
+      slot.store(&info, std::memory_order_release);
+    }
+
+    // replaces the classes whose registration (its table of ancestors included) or `type_info` lies in `ranges`
+    // by tombstones, before their module is unloaded; returns the number of classes removed
+    std::size_t erase_in_ranges(const std::vector<address_range>& ranges)
+    {
+      std::lock_guard lock{ mutex };
+      if (tables.empty())
+        return 0;
+
+      std::size_t erased_count = 0;
+      for (std::atomic<const registered_class_info*>& slot : *tables.back())
+      {
+        const registered_class_info* const registered = slot.load(std::memory_order_relaxed);
+        if (registered != nullptr && registered != &erased_class
+         && (is_in_ranges(registered, ranges) || is_in_ranges(registered->type, ranges)
+          || is_in_ranges(registered->ancestors, ranges)))
+        {
+          slot.store(&erased_class, std::memory_order_release);
+          ++erased_count;
+        }
+      }
+      return erased_count;
+    }
+
+    [[nodiscard]] const registered_class_info* find(const std::type_info& type) const noexcept
+    {
+      const table* const current_table = current.load(std::memory_order_acquire);
+      if (current_table == nullptr)
+        return nullptr;
+
+      const std::size_t mask = current_table->size() - 1;
+      for (std::size_t index = hash(type) & mask; ; index = (index + 1) & mask)
+      {
+        const registered_class_info* const registered = (*current_table)[index].load(std::memory_order_acquire);
+        if (registered == nullptr || registered->type == &type)
+          return registered;
+      }
+    }
+
+  private:
+    using table = std::vector<std::atomic<const registered_class_info*>>;
+
+    std::atomic<const table*> current{ nullptr };
+    std::mutex mutex;
+    std::vector<std::unique_ptr<table>> tables; // the last one is `current`
+    std::size_t used_slot_count = 0; // the tombstones included
+
+    // matches no `type_info`, so lookups and insertions probe past it
+    static constexpr registered_class_info erased_class{ nullptr, nullptr, 0 };
+
+    [[nodiscard]] static std::size_t hash(const std::type_info& type) noexcept
+    {
+      return static_cast<std::size_t>((reinterpret_cast<std::uintptr_t>(&type) * 0x9E3779B97F4A7C15ull) >> 16);
+    }
+
+    // either the slot holding `type` or the empty slot where it should be inserted
+    [[nodiscard]] static std::atomic<const registered_class_info*>& slot_for(table& target, const std::type_info& type) noexcept
+    {
+      const std::size_t mask = target.size() - 1;
+      for (std::size_t index = hash(type) & mask; ; index = (index + 1) & mask)
+      {
+        const registered_class_info* const registered = target[index].load(std::memory_order_relaxed);
+        if (registered == nullptr || registered->type == &type)
+          return target[index];
+      }
+    }
+  };
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE bool register_class(const registered_class_info& info)
+  {
+    registered_class_registry::instance().add(info);
+    return true;
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE const registered_class_info* find_registered_class(const std::type_info& dynamic_type) noexcept
+  {
+    return registered_class_registry::instance().find(dynamic_type);
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t erase_registered_classes_in_ranges(const std::vector<address_range>& ranges)
+  {
+    return registered_class_registry::instance().erase_in_ranges(ranges);
+  }
+
+  // the growth of all the rows of `cached_dynamic_cast_intrusive` classes; the storage a row outgrew is kept
+  // around, as readers take no lock, but a row at least doubles each time, so that is less than its own size
+  struct intrusive_row_registry
+  {
+    static intrusive_row_registry& instance()
+    {
+      static intrusive_row_registry registry;
+      return registry;
+    }
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<intrusive_key_row>> key_rows;
+    std::vector<std::unique_ptr<intrusive_cast_row_storage>> storages;
+  };
+
+  // must be called with the mutex of the registry locked
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE intrusive_key_row& add_intrusive_key_row(intrusive_cast_row& row,
+                                                                                          const void* const dynamic_key)
+  {
+    std::atomic<intrusive_key_row*>* link = &row.first_key_row;
+    for (intrusive_key_row* key_row = link->load(std::memory_order_acquire); key_row != nullptr; key_row = link->load(std::memory_order_acquire))
+    {
+      if (key_row->dynamic_key == dynamic_key)
+        return *key_row; // added by another thread meanwhile
+      link = &key_row->next;
+    }
+    std::vector<std::unique_ptr<intrusive_key_row>>& key_rows = intrusive_row_registry::instance().key_rows;
+    key_rows.push_back(std::unique_ptr<intrusive_key_row>{ new intrusive_key_row{ dynamic_key } });
+    link->store(key_rows.back().get(), std::memory_order_release);
+    return *key_rows.back();
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void store_in_intrusive_row(intrusive_cast_row& row, const void* const dynamic_key,
+                                                               const std::size_t cast_id, const intrusive_row_entry entry)
+  {
+    intrusive_key_row* key_row = row.find_key_row(dynamic_key);
+    intrusive_cast_row_storage* storage = (key_row != nullptr) ? key_row->storage.load(std::memory_order_acquire) : nullptr;
+    if (storage == nullptr || cast_id >= storage->size)
+    {
+      intrusive_row_registry& registry = intrusive_row_registry::instance();
+      std::lock_guard lock{ registry.mutex };
+      if (key_row == nullptr)
+        key_row = &add_intrusive_key_row(row, dynamic_key);
+      storage = key_row->storage.load(std::memory_order_acquire); // another thread may have grown it meanwhile
+      if (storage == nullptr || cast_id >= storage->size)
+      {
+        const std::size_t old_size = (storage != nullptr) ? storage->size : 0;
+        auto grown = std::make_unique<intrusive_cast_row_storage>(std::max<std::size_t>({ cast_id + 1, old_size * 2, 16 }));
+        for (std::size_t index = 0; index < old_size; ++index)
+          grown->entries[index].store(storage->entries[index].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        storage = grown.get();
+        registry.storages.push_back(std::move(grown));
+        key_row->storage.store(storage, std::memory_order_release);
+      }
+    }
+    // a store into the old storage racing with the growth is merely lost, the next cast stores it again
+    storage->entries[cast_id].store(entry, std::memory_order_relaxed);
+  }
+
+  struct pair_statistics_key
+  {
+    const std::type_info* destination_type;
+    const std::type_info* dynamic_type;
+    const char* file;
+    unsigned line;
+
+    friend bool operator==(const pair_statistics_key& lhs, const pair_statistics_key& rhs) noexcept
+    {
+      return lhs.destination_type == rhs.destination_type && lhs.dynamic_type == rhs.dynamic_type
+          && lhs.file == rhs.file && lhs.line == rhs.line;
+    }
+  };
+
+  struct pair_statistics_key_hash
+  {
+    std::size_t operator()(const pair_statistics_key& key) const noexcept
+    {
+      std::size_t hash = std::hash<const void*>{}(key.destination_type);
+      hash = hash * 31 + std::hash<const void*>{}(key.dynamic_type);
+      hash = hash * 31 + std::hash<const void*>{}(key.file);
+      return hash * 31 + key.line;
+    }
+  };
+
+  struct pair_statistics_counts
+  {
+    std::uint64_t counts[3]{}; // indexed by `lookup_outcome`
+  };
+
+  using pair_statistics_map = std::unordered_map<pair_statistics_key, pair_statistics_counts, pair_statistics_key_hash>;
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void merge_pair_statistics(pair_statistics_map& target, const pair_statistics_map& source)
+  {
+    for (const auto& [key, source_counts] : source)
+    {
+      pair_statistics_counts& target_counts = target[key];
+      for (int i = 0; i < 3; ++i)
+        target_counts.counts[i] += source_counts.counts[i];
+    }
+  }
+
+  // the per-pair counts of a thread, an open-addressing table written only by that thread (so, like
+  // `thread_statistics_counters`, no read-modify-write is needed) and read by `cached_dynamic_cast_stats()`;
+  // zero-initialized and trivially destructible, so that the casts made by later thread-local destructors,
+  // after `thread_statistics_owner` has gone, still find it (and see `is_finished`)
+  struct thread_pair_statistics
+  {
+    static constexpr std::size_t slot_count = statistics_level > 1 ? 128 : 1;
+    static constexpr std::size_t max_probe_count = 8; // the pairs beyond it go to `thread_entry::overflow_pairs`
+
+    enum slot_state : unsigned char { empty_slot, used_slot, erased_slot };
+
+    struct slot
+    {
+      std::atomic<slot_state> state; // to `used_slot` after the key, by the thread; to `erased_slot` by any thread
+      std::atomic<const std::type_info*> destination_type;
+      std::atomic<const std::type_info*> dynamic_type;
+      std::atomic<const char*> file;
+      std::atomic<unsigned> line;
+      std::atomic<std::uint64_t> counts[3]; // indexed by `lookup_outcome`
+    };
+
+    slot slots[slot_count];
+    bool is_finished; // the counts have been moved to the totals, see `thread_statistics_owner`
+  };
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE thread_local thread_pair_statistics thread_pairs;
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void merge_pair_statistics(pair_statistics_map& target, const thread_pair_statistics& source)
+  {
+    for (const thread_pair_statistics::slot& slot : source.slots)
+    {
+      if (slot.state.load(std::memory_order_acquire) != thread_pair_statistics::used_slot)
+        continue;
+      pair_statistics_counts& target_counts = target[pair_statistics_key{
+        slot.destination_type.load(std::memory_order_relaxed), slot.dynamic_type.load(std::memory_order_relaxed),
+        slot.file.load(std::memory_order_relaxed), slot.line.load(std::memory_order_relaxed) }];
+      for (int i = 0; i < 3; ++i)
+        target_counts.counts[i] += slot.counts[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  // counters of the running threads, and the totals of the finished ones
+  struct statistics_registry
+  {
+    struct thread_entry
+    {
+      thread_statistics_counters* counters;
+      thread_pair_statistics* pairs;
+      std::mutex overflow_mutex; // only contended while the statistics are being collected
+      pair_statistics_map overflow_pairs; // those which found no slot in `pairs`
+    };
+
+    std::mutex mutex;
+    std::vector<thread_entry*> threads;
+    cached_dynamic_cast_statistics finished_threads_totals{};
+    pair_statistics_map finished_threads_pairs;
+
+    static statistics_registry& instance()
+    {
+      static statistics_registry registry;
+      return registry;
+    }
+  };
+
+  // moves the counts of its thread to the totals when the thread finishes
+  struct thread_statistics_owner
+  {
+    statistics_registry::thread_entry entry;
+
+    thread_statistics_owner()
+    {
+      entry.counters = &thread_statistics;
+      entry.pairs = &thread_pairs;
+      statistics_registry& registry = statistics_registry::instance();
+      std::lock_guard lock{ registry.mutex };
+      registry.threads.push_back(&entry);
+    }
+
+    ~thread_statistics_owner()
+    {
+      statistics_registry& registry = statistics_registry::instance();
+      std::lock_guard lock{ registry.mutex };
+      cached_dynamic_cast_statistics& totals = registry.finished_threads_totals;
+      totals.hits += thread_statistics.hits.load(std::memory_order_relaxed);
+      totals.negative_hits += thread_statistics.negative_hits.load(std::memory_order_relaxed);
+      totals.misses += thread_statistics.misses.load(std::memory_order_relaxed);
+      totals.slow_path_nanoseconds += thread_statistics.slow_path_nanoseconds.load(std::memory_order_relaxed);
+      totals.writer_lock_wait_nanoseconds += thread_statistics.writer_lock_wait_nanoseconds.load(std::memory_order_relaxed);
+      merge_pair_statistics(registry.finished_threads_pairs, thread_pairs);
+      if (std::lock_guard overflow_lock{ entry.overflow_mutex }; true)
+        merge_pair_statistics(registry.finished_threads_pairs, entry.overflow_pairs);
+      registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), &entry));
+      // casts made later by other thread-local destructors are not counted anymore
+      thread_pairs.is_finished = true;
+    }
+
+    static thread_statistics_owner& instance()
+    {
+      thread_local thread_statistics_owner owner;
+      return owner;
+    }
+  };
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void register_thread_statistics()
+  {
+    static_cast<void>(thread_statistics_owner::instance());
+    thread_statistics.is_registered = true;
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void count_pair_lookup(const std::type_info& destination_type,
+                                                           const std::type_info& dynamic_type,
+                                                           const call_location& caller, const lookup_outcome outcome,
+                                                           const std::uint64_t count)
+  {
+    if (thread_pairs.is_finished)
+      return;
+    if (!thread_statistics.is_registered)
+      register_thread_statistics();
+
+    const auto increment = [outcome, count](std::atomic<std::uint64_t> (&counts)[3])
+    {
+      std::atomic<std::uint64_t>& outcome_count = counts[static_cast<int>(outcome)];
+      outcome_count.store(outcome_count.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    };
+
+    const pair_statistics_key key{ &destination_type, &dynamic_type, caller.file, caller.line };
+    const std::size_t hash = pair_statistics_key_hash{}(key);
+    for (std::size_t probe = 0; probe < thread_pair_statistics::max_probe_count; ++probe)
+    {
+      thread_pair_statistics::slot& slot = thread_pairs.slots[(hash + probe) % thread_pair_statistics::slot_count];
+      // an erased slot is taken over like an empty one; if that leaves the pair in two slots,
+      // `merge_pair_statistics()` adds their counts up
+      if (slot.state.load(std::memory_order_relaxed) != thread_pair_statistics::used_slot)
+      {
+        slot.destination_type.store(key.destination_type, std::memory_order_relaxed);
+        slot.dynamic_type.store(key.dynamic_type, std::memory_order_relaxed);
+        slot.file.store(key.file, std::memory_order_relaxed);
+        slot.line.store(key.line, std::memory_order_relaxed);
+        for (std::atomic<std::uint64_t>& count : slot.counts)
+          count.store(0, std::memory_order_relaxed);
+        increment(slot.counts);
+        slot.state.store(thread_pair_statistics::used_slot, std::memory_order_release);
+        return;
+      }
+      if (slot.destination_type.load(std::memory_order_relaxed) == key.destination_type
+       && slot.dynamic_type.load(std::memory_order_relaxed) == key.dynamic_type
+       && slot.file.load(std::memory_order_relaxed) == key.file && slot.line.load(std::memory_order_relaxed) == key.line)
+      {
+        increment(slot.counts);
+        return;
+      }
+    }
+
+    statistics_registry::thread_entry& entry = thread_statistics_owner::instance().entry;
+    std::lock_guard overflow_lock{ entry.overflow_mutex };
+    entry.overflow_pairs[key].counts[static_cast<int>(outcome)] += count;
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE void erase_pair_statistics_in_ranges(const std::vector<address_range>& ranges)
+  {
+    if constexpr (statistics_level > 1)
+    {
+      const auto erase_from = [&ranges](pair_statistics_map& pairs)
+      {
+        for (auto pair = pairs.begin(); pair != pairs.end(); )
+        {
+          const pair_statistics_key& key = pair->first;
+          if (is_in_ranges(key.destination_type, ranges) || is_in_ranges(key.dynamic_type, ranges) || is_in_ranges(key.file, ranges))
+            pair = pairs.erase(pair);
+          else
+            ++pair;
+        }
+      };
+
+      statistics_registry& registry = statistics_registry::instance();
+      std::lock_guard lock{ registry.mutex };
+      erase_from(registry.finished_threads_pairs);
+      for (statistics_registry::thread_entry* const entry : registry.threads)
+      {
+        for (thread_pair_statistics::slot& slot : entry->pairs->slots)
+          if (slot.state.load(std::memory_order_acquire) == thread_pair_statistics::used_slot
+           && (is_in_ranges(slot.destination_type.load(std::memory_order_relaxed), ranges)
+            || is_in_ranges(slot.dynamic_type.load(std::memory_order_relaxed), ranges)
+            || is_in_ranges(slot.file.load(std::memory_order_relaxed), ranges)))
+            slot.state.store(thread_pair_statistics::erased_slot, std::memory_order_relaxed);
+        std::lock_guard overflow_lock{ entry->overflow_mutex };
+        erase_from(entry->overflow_pairs);
+      }
+    }
+    else
+    {
+      static_cast<void>(ranges);
+    }
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE call_site_cache_base::call_site_cache_base(const char* file, unsigned line)
+    : file{ file }
+    , line{ line }
+  {
+    call_site_registry::add(*this);
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE call_site_cache_base::~call_site_cache_base()
+  {
+    call_site_registry::remove(*this);
+  }
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void reset_cached_dynamic_cast_global_cache()
+{
+  default_cast_cache().reset();
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE cached_dynamic_cast_global_cache_usage get_cached_dynamic_cast_global_cache_usage()
+{
+  return default_cast_cache().usage();
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void set_cached_dynamic_cast_global_cache_capacity(const std::size_t capacity)
+{
+  default_cast_cache().set_capacity(capacity);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void compact_cached_dynamic_cast_global_cache()
+{
+  default_cast_cache().compact();
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t erase_cached_dynamic_casts_in_address_range(const void* const begin, const void* const end)
+{
+  return default_cast_cache().erase_address_range(begin, end);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::size_t erase_cached_dynamic_casts_of_module(const void* const address_in_module)
+{
+  return default_cast_cache().erase_module(address_in_module);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void prewarm_registered_cached_dynamic_casts(const unsigned thread_count)
+{
+  using namespace detail::cached_dynamic_cast_detail;
+  const std::vector<prewarm_function>& prewarms = registered_prewarms();
+
+  // every thread collects its share first and then stores it at once
+  std::atomic<std::size_t> next_index{ 0 };
+  const auto run = [&]
+  {
+    std::vector<cache_entry> entries;
+    for (std::size_t index = next_index++; index < prewarms.size(); index = next_index++)
+      prewarms[index](entries);
+    store_many_in_global_cache(entries.data(), entries.size());
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < std::min<std::size_t>(thread_count, prewarms.size()); ++i)
+    threads.emplace_back(run);
+  run();
+  for (std::thread& thread : threads)
+    thread.join();
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::vector<cached_dynamic_cast_call_site_statistics> collect_cached_dynamic_cast_call_site_statistics()
+{
+  return detail::cached_dynamic_cast_detail::call_site_registry::collect();
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE cached_dynamic_cast_statistics cached_dynamic_cast_stats()
+{
+  using namespace detail::cached_dynamic_cast_detail;
+  statistics_registry& registry = statistics_registry::instance();
+  std::lock_guard lock{ registry.mutex };
+
+  cached_dynamic_cast_statistics result = registry.finished_threads_totals;
+  pair_statistics_map pairs = registry.finished_threads_pairs;
+  for (statistics_registry::thread_entry* const entry : registry.threads)
+  {
+    result.hits += entry->counters->hits.load(std::memory_order_relaxed);
+    result.negative_hits += entry->counters->negative_hits.load(std::memory_order_relaxed);
+    result.misses += entry->counters->misses.load(std::memory_order_relaxed);
+    result.slow_path_nanoseconds += entry->counters->slow_path_nanoseconds.load(std::memory_order_relaxed);
+    result.writer_lock_wait_nanoseconds += entry->counters->writer_lock_wait_nanoseconds.load(std::memory_order_relaxed);
+    merge_pair_statistics(pairs, *entry->pairs);
+    std::lock_guard overflow_lock{ entry->overflow_mutex };
+    merge_pair_statistics(pairs, entry->overflow_pairs);
+  }
+
+  result.pairs.clear();
+  for (const auto& [key, counts] : pairs)
+  {
+    result.pairs.push_back(cached_dynamic_cast_pair_statistics{
+      key.destination_type->name(),
+      key.dynamic_type->name(),
+      key.file,
+      key.line,
+      counts.counts[static_cast<int>(lookup_outcome::hit)],
+      counts.counts[static_cast<int>(lookup_outcome::negative_hit)],
+      counts.counts[static_cast<int>(lookup_outcome::miss)] });
+  }
+  std::sort(result.pairs.begin(), result.pairs.end(),
+            [](const cached_dynamic_cast_pair_statistics& lhs, const cached_dynamic_cast_pair_statistics& rhs)
+            {
+              return lhs.hits + lhs.negative_hits + lhs.misses > rhs.hits + rhs.negative_hits + rhs.misses;
+            });
+  return result;
+}
+
+namespace detail::cached_dynamic_cast_detail
+{
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::string readable_type_name(const char* const name)
+  {
+#if defined(__GXX_ABI_VERSION) && __has_include(<cxxabi.h>)
+    int status = 0;
+    char* const demangled_name = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (demangled_name != nullptr)
+    {
+      std::string result{ demangled_name };
+      std::free(demangled_name);
+      return result;
+    }
+#endif
+    return name;
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::string json_string(const std::string& value)
+  {
+    std::string result = "\"";
+    for (const char c : value)
+    {
+      if (c == '"' || c == '\\')
+      {
+        result += '\\';
+        result += c;
+      }
+      else if (static_cast<unsigned char>(c) < 0x20)
+      {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+        result += escaped;
+      }
+      else
+      {
+        result += c;
+      }
+    }
+    return result + '"';
+  }
+} // namespace detail::cached_dynamic_cast_detail
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::string cached_dynamic_cast_statistics::to_text() const
+{
+  using detail::cached_dynamic_cast_detail::readable_type_name;
+  std::string result;
+  result += "hits: " + std::to_string(hits) + '\n';
+  result += "negative hits: " + std::to_string(negative_hits) + '\n';
+  result += "misses: " + std::to_string(misses) + '\n';
+  result += "slow path: " + std::to_string(slow_path_nanoseconds) + " ns\n";
+  result += "writer lock wait: " + std::to_string(writer_lock_wait_nanoseconds) + " ns\n";
+  for (const cached_dynamic_cast_pair_statistics& pair : pairs)
+  {
+    result += readable_type_name(pair.dynamic_type) + " -> " + readable_type_name(pair.destination_type);
+    if (pair.file != nullptr)
+      result += std::string{ " at " } + pair.file + ':' + std::to_string(pair.line);
+    result += ": " + std::to_string(pair.hits) + " hits, " + std::to_string(pair.negative_hits) + " negative hits, "
+            + std::to_string(pair.misses) + " misses\n";
+  }
+  return result;
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::string cached_dynamic_cast_statistics::to_json() const
+{
+  using detail::cached_dynamic_cast_detail::readable_type_name;
+  using detail::cached_dynamic_cast_detail::json_string;
+  std::string result = "{";
+  result += "\"hits\":" + std::to_string(hits);
+  result += ",\"negative_hits\":" + std::to_string(negative_hits);
+  result += ",\"misses\":" + std::to_string(misses);
+  result += ",\"slow_path_nanoseconds\":" + std::to_string(slow_path_nanoseconds);
+  result += ",\"writer_lock_wait_nanoseconds\":" + std::to_string(writer_lock_wait_nanoseconds);
+  result += ",\"pairs\":[";
+  for (const cached_dynamic_cast_pair_statistics& pair : pairs)
+  {
+    if (&pair != &pairs.front())
+      result += ',';
+    result += "{\"destination_type\":" + json_string(readable_type_name(pair.destination_type));
+    result += ",\"dynamic_type\":" + json_string(readable_type_name(pair.dynamic_type));
+    if (pair.file != nullptr)
+      result += ",\"file\":" + json_string(pair.file) + ",\"line\":" + std::to_string(pair.line);
+    result += ",\"hits\":" + std::to_string(pair.hits);
+    result += ",\"negative_hits\":" + std::to_string(pair.negative_hits);
+    result += ",\"misses\":" + std::to_string(pair.misses) + '}';
+  }
+  return result + "]}";
 }
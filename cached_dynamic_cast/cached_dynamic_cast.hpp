@@ -1,187 +1,2188 @@
 #pragma once
 
-#include <unordered_map>
-#include <shared_mutex>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <typeinfo>
-#include <typeindex>
 #include <type_traits>
 #include <limits>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
 #include <utility>
+#include <vector>
+#include <cstring>
+#if __cplusplus >= 202002L && __has_include(<source_location>)
+#include <source_location>
+#endif
+
+// number of entries in the per-thread direct-mapped cache placed in front of the global cache
+// (must be a power of two; 0 disables the thread-local cache completely)
+#ifndef CACHED_DYNAMIC_CAST_THREAD_LOCAL_CACHE_SIZE
+#define CACHED_DYNAMIC_CAST_THREAD_LOCAL_CACHE_SIZE 64
+#endif
+
+// storage behind the thread-local cache:
+// `CACHED_DYNAMIC_CAST_BACKEND_LOCKED_TABLE` - one hash table guarded by a reader-writer lock
+// `CACHED_DYNAMIC_CAST_BACKEND_SNAPSHOT` - immutable snapshots published through an atomic pointer, lock-free readers,
+//                                         but every miss copies the whole table (best when new pairs stop appearing)
+#define CACHED_DYNAMIC_CAST_BACKEND_LOCKED_TABLE 1
+#define CACHED_DYNAMIC_CAST_BACKEND_SNAPSHOT 2
+#ifndef CACHED_DYNAMIC_CAST_BACKEND
+#define CACHED_DYNAMIC_CAST_BACKEND CACHED_DYNAMIC_CAST_BACKEND_LOCKED_TABLE
+#endif
+
+// number of independently locked parts of the `CACHED_DYNAMIC_CAST_BACKEND_LOCKED_TABLE` global cache
+#ifndef CACHED_DYNAMIC_CAST_GLOBAL_CACHE_SHARDS
+#define CACHED_DYNAMIC_CAST_GLOBAL_CACHE_SHARDS 8
+#endif
+
+// keep a replica of every global cache per NUMA node, so that lookups read memory of the caller's own node:
+// 0 - a single table
+// 1 - a replica per NUMA node of the machine, picked by the node the calling thread runs on
+// N > 1 - N replicas, picked by that node modulo N (for trying the layout out on machines with fewer nodes)
+// misses store into the caller's replica, the other replicas pick new entries up when they miss themselves
+#ifndef CACHED_DYNAMIC_CAST_NUMA_REPLICAS
+#define CACHED_DYNAMIC_CAST_NUMA_REPLICAS 0
+#endif
+
+// consult a matrix of every global cache after the thread-local cache, before the table: a row per source dynamic
+// key, numbered on its first store, a column per pair of source static and destination types, numbered on the
+// first use of the cast; a hit takes no lock, no fence and compares no `cache_key`, the matrix holds copies of
+// the entries of the table (as many as the capacity of the table allows, the pairs beyond are left to the table);
+// it comes second because the thread-local cache needs no number of the cast, and its memory is only given back
+// when the domain is destroyed
+#ifndef CACHED_DYNAMIC_CAST_TYPE_MATRIX
+#define CACHED_DYNAMIC_CAST_TYPE_MATRIX 0
+#endif
+
+// identify the source DYNAMIC type by the object's vtable pointer rather than by its `type_info`;
+// only safe where a polymorphic object is guaranteed to start with its vtable pointer (Itanium C++ ABI)
+#ifndef CACHED_DYNAMIC_CAST_USE_VPTR_KEYS
+#if defined(__GXX_ABI_VERSION)
+#define CACHED_DYNAMIC_CAST_USE_VPTR_KEYS 1
+#else
+#define CACHED_DYNAMIC_CAST_USE_VPTR_KEYS 0
+#endif
+#endif
+
+// number of entries of the table owned by every `cached_dynamic_cast<Destination*>(Source*)` instantiation,
+// consulted before the thread-local cache (0 disables these tables; see `per_instantiation_cache()`)
+#ifndef CACHED_DYNAMIC_CAST_PER_INSTANTIATION_CACHE_SIZE
+#define CACHED_DYNAMIC_CAST_PER_INSTANTIATION_CACHE_SIZE 0
+#endif
+
+// the maximum number of entries in the global cache, older entries are evicted when it is full
+// (0 means unbounded; can also be changed at run time by `set_cached_dynamic_cast_global_cache_capacity()`;
+// every shard of the `CACHED_DYNAMIC_CAST_BACKEND_LOCKED_TABLE` cache evicts on its own, once it holds its share)
+#ifndef CACHED_DYNAMIC_CAST_GLOBAL_CACHE_CAPACITY
+#define CACHED_DYNAMIC_CAST_GLOBAL_CACHE_CAPACITY 0
+#endif
+
+// count lookups of every `cached_dynamic_cast_call_site` (costs an atomic increment per cast at such call sites)
+#ifndef CACHED_DYNAMIC_CAST_CALL_SITE_COUNTERS
+#define CACHED_DYNAMIC_CAST_CALL_SITE_COUNTERS 0
+#endif
+
+// opt-in instrumentation, see `cached_dynamic_cast_stats()`:
+// 0 - compiled out completely
+// 1 - per-thread counters of hits, negative hits and misses, time spent in the slow path and waiting for writer locks
+// 2 - additionally, counts per (destination type, dynamic type) pair, and per caller in C++20 builds
+#ifndef CACHED_DYNAMIC_CAST_STATISTICS
+#define CACHED_DYNAMIC_CAST_STATISTICS 0
+#endif
+
+// static tracepoints (USDT, provider `cached_dynamic_cast`) for perf, bpftrace and SystemTap, a NOP each until
+// a tool attaches to it:
+// slow_path_entry(destination type name, dynamic type name)
+// slow_path_exit(destination type name, dynamic type name, nanoseconds spent in `dynamic_cast`, 1 if it succeeded)
+// writer_lock(shard index, nanoseconds spent waiting for the lock)
+// insert(destination type name, dynamic type key, offset, cast_cache address)
+// reset(cast_cache address, new epoch)
+// the type names are mangled; the arguments are computed (and the durations measured) only while attached;
+// needs <sys/sdt.h> to build the library, and the library itself: there are no probes in the header-only build
+#ifndef CACHED_DYNAMIC_CAST_USDT_PROBES
+#define CACHED_DYNAMIC_CAST_USDT_PROBES 0
+#endif
+
+// 1: no library to link, cached_dynamic_cast.cpp and cached_dynamic_cast_snapshot_file.cpp are included
+// by this header and define everything (the global state included) as inline functions and variables
+#ifndef CACHED_DYNAMIC_CAST_HEADER_ONLY
+#define CACHED_DYNAMIC_CAST_HEADER_ONLY 0
+#endif
+
+#if CACHED_DYNAMIC_CAST_HEADER_ONLY
+#define CACHED_DYNAMIC_CAST_DETAIL_INLINE inline
+#undef CACHED_DYNAMIC_CAST_USDT_PROBES
+#define CACHED_DYNAMIC_CAST_USDT_PROBES 0 // the semaphores of the probes must be defined once, by the library
+#else
+#define CACHED_DYNAMIC_CAST_DETAIL_INLINE
+#endif
+
+// the public overloads get an extra defaulted parameter where the callers can be told apart
+#if CACHED_DYNAMIC_CAST_STATISTICS >= 2 && defined(__cpp_lib_source_location)
+#define CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER , const std::source_location caller = std::source_location::current()
+#define CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT , caller
+#define CACHED_DYNAMIC_CAST_DETAIL_CALLER ::detail::cached_dynamic_cast_detail::call_location{ caller.file_name(), caller.line() }
+#else
+#define CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER
+#define CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT
+#define CACHED_DYNAMIC_CAST_DETAIL_CALLER ::detail::cached_dynamic_cast_detail::call_location{}
+#endif
+
+#if CACHED_DYNAMIC_CAST_USDT_PROBES
+// incremented by the tools attached to the probe of the same name; defined, like the probes themselves,
+// in cached_dynamic_cast.cpp, so that <sys/sdt.h> never reaches the translation units of the users
+extern "C"
+{
+  extern volatile unsigned short cached_dynamic_cast_slow_path_entry_semaphore;
+  extern volatile unsigned short cached_dynamic_cast_slow_path_exit_semaphore;
+  extern volatile unsigned short cached_dynamic_cast_writer_lock_semaphore;
+  extern volatile unsigned short cached_dynamic_cast_insert_semaphore;
+  extern volatile unsigned short cached_dynamic_cast_reset_semaphore;
+}
+#define CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(name) (cached_dynamic_cast_##name##_semaphore != 0)
+#else
+#define CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(name) false
+#endif
+
+namespace detail::cached_dynamic_cast_detail
+{
+  using offset_type = signed int; // could've been `std::ptrdiff_t`, but this should be enough in practice
+
+  // special offset values, never produced by `checked_cast_to_offset()`
+  inline constexpr offset_type impossible_cast_offset = std::numeric_limits<offset_type>::min();
+  inline constexpr offset_type missing_entry_offset = std::numeric_limits<offset_type>::max();
+
+  // a pointer-sized value identifying the DYNAMIC type of a polymorphic object: a single load of its vtable pointer
+  // compared by address, instead of a `type_info` whose hashing and comparison may involve the mangled name;
+  // a vtable pointer also tells which base class subobject is pointed to, so even casts from objects under
+  // construction or from one of several same-typed base class subobjects get entries of their own
+  template<typename SourceValue>
+  [[nodiscard]] inline const void* dynamic_type_key(SourceValue* const source_pointer) noexcept
+  {
+#if CACHED_DYNAMIC_CAST_USE_VPTR_KEYS
+    const void* vptr;
+    std::memcpy(&vptr, const_cast<const void*>(static_cast<const volatile void*>(source_pointer)), sizeof(vptr));
+    return vptr;
+#else
+    return &typeid(*source_pointer);
+#endif
+  }
+
+  // replaced on every reset of a cache domain so that thread-local entries become stale; every domain draws
+  // its epochs from one counter, so an epoch also tells which domain a thread-local entry belongs to
+  using epoch_type = std::uint32_t; // wrapping around is harmless: a resurrected entry still holds a valid result
+
+  [[nodiscard]] epoch_type next_cache_epoch() noexcept; // never 0
+
+  [[nodiscard]] inline offset_type checked_cast_to_offset(const std::ptrdiff_t wide_offset)
+  {
+    if ((wide_offset > static_cast<std::ptrdiff_t>(std::numeric_limits<offset_type>::min()))
+     && (wide_offset < static_cast<std::ptrdiff_t>(std::numeric_limits<offset_type>::max())))
+      return static_cast<offset_type>(wide_offset);
+    else
+      throw std::logic_error{"offset is too large"};
+  }
+
+  struct cache_key
+  {
+    const std::type_info* destination_type;    // destination STATIC type
+    const void* source_dynamic_key;            // source DYNAMIC type, see `dynamic_type_key()`
+    const std::type_info* source_static_type;  // source STATIC type
+  };
+
+  struct cache_entry
+  {
+    cache_key key;
+    offset_type offset; // an offset or `impossible_cast_offset`
+  };
+
+  inline constexpr std::size_t per_instantiation_cache_size = CACHED_DYNAMIC_CAST_PER_INSTANTIATION_CACHE_SIZE;
+
+  inline constexpr std::size_t global_cache_capacity = CACHED_DYNAMIC_CAST_GLOBAL_CACHE_CAPACITY;
+
+  inline constexpr std::size_t global_cache_shard_count = CACHED_DYNAMIC_CAST_GLOBAL_CACHE_SHARDS;
+  static_assert(global_cache_shard_count > 0, "CACHED_DYNAMIC_CAST_GLOBAL_CACHE_SHARDS must be positive");
+
+  inline constexpr int numa_replicas = CACHED_DYNAMIC_CAST_NUMA_REPLICAS;
+  static_assert(numa_replicas >= 0, "CACHED_DYNAMIC_CAST_NUMA_REPLICAS must not be negative");
+
+  inline constexpr bool type_matrix_enabled = CACHED_DYNAMIC_CAST_TYPE_MATRIX != 0;
+
+  // >= 0: the NUMA node the calling thread is taken to run on, instead of the one it does
+  // (lets the tests and the benchmarks spread threads over the replicas on any machine)
+  inline thread_local int numa_node_override = -1;
+
+  inline constexpr std::size_t thread_local_cache_size = CACHED_DYNAMIC_CAST_THREAD_LOCAL_CACHE_SIZE;
+  static_assert((thread_local_cache_size & (thread_local_cache_size - 1)) == 0,
+                "CACHED_DYNAMIC_CAST_THREAD_LOCAL_CACHE_SIZE must be a power of two");
+
+  // `type_info` objects are compared by address here: two distinct objects describing the same type
+  // (which may happen across shared libraries) merely occupy two entries, the results stay correct
+  struct thread_local_cache_entry
+  {
+    cache_key key;
+    epoch_type epoch; // 0 is never a valid epoch, so zero-initialized entries are always stale
+    offset_type offset;
+  };
+
+  struct thread_local_cache_type
+  {
+    thread_local_cache_entry entries[thread_local_cache_size > 0 ? thread_local_cache_size : 1];
+  };
+
+  // zero-initialized at compile time, so accessing it does not go through a TLS init wrapper
+  inline thread_local thread_local_cache_type thread_local_cache{};
+
+  // the low bits of the addresses are mostly zeroes and the high bits mostly equal, so all of them get mixed
+  [[nodiscard]] inline std::size_t hash_key(const cache_key& key) noexcept
+  {
+    std::uint64_t hash = reinterpret_cast<std::uintptr_t>(key.destination_type);
+    hash = (hash ^ reinterpret_cast<std::uintptr_t>(key.source_dynamic_key)) * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+    hash = (hash ^ reinterpret_cast<std::uintptr_t>(key.source_static_type)) * 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 32;
+    return static_cast<std::size_t>(hash);
+  }
+
+  [[nodiscard]] inline bool same_key(const cache_key& lhs, const cache_key& rhs) noexcept
+  {
+    return lhs.destination_type == rhs.destination_type
+        && lhs.source_dynamic_key == rhs.source_dynamic_key
+        && lhs.source_static_type == rhs.source_static_type;
+  }
+
+  [[nodiscard]] inline thread_local_cache_entry& thread_local_cache_slot(const cache_key& key) noexcept
+  {
+    return thread_local_cache.entries[hash_key(key) & (thread_local_cache_size - 1)];
+  }
+
+  // set once a snapshot has been imported, see `import_cached_dynamic_cast_snapshot()`
+  extern std::atomic<bool> has_imported_snapshot;
+  [[nodiscard]] offset_type find_in_imported_snapshot(const cache_key& key, const std::type_info& dynamic_type);
+
+  // in cached_dynamic_cast.cpp, see `CACHED_DYNAMIC_CAST_USDT_PROBES`; call only while the probe is enabled
+  void fire_slow_path_entry_probe(const std::type_info& destination_type, const std::type_info& dynamic_type) noexcept;
+  void fire_slow_path_exit_probe(const std::type_info& destination_type, const std::type_info& dynamic_type,
+                                 std::uint64_t dynamic_cast_nanoseconds, bool has_succeeded) noexcept;
+
+  class cast_cache_storage; // the backend selected by `CACHED_DYNAMIC_CAST_BACKEND`, see cached_dynamic_cast_backends.hpp
+
+  // in cached_dynamic_cast.cpp: numbers in the order of the first use
+  [[nodiscard]] std::size_t allocate_dense_cast_id() noexcept;
+
+  // a pair of a source static type and a destination type, numbered densely: a column of a `type_matrix`
+  // or of an `intrusive_cast_row` (a function-local static, so that casts during static initialization get one too)
+  template<typename SourceValueNoCV, typename DestinationValueNoCV>
+  [[nodiscard]] inline std::size_t dense_cast_id() noexcept
+  {
+    static const std::size_t cast_id = allocate_dense_cast_id();
+    return cast_id;
+  }
+
+  // see `CACHED_DYNAMIC_CAST_TYPE_MATRIX`: offsets indexed by a dense number of the source dynamic key and by
+  // `dense_cast_id()`; a dynamic key is numbered on its first store, through an open-addressing table keyed by it,
+  // and the number indexes a directory of rows; a row points to blocks of `block_size` columns, allocated on the
+  // first store into one of them, so that a row takes memory for the columns its dynamic key is cast with;
+  // a cell holds its offset together with the epoch of the domain it was stored in, so a reset or an erasure
+  // empties the matrix without touching it, and a store racing with one never shows up in the new epoch;
+  // nothing a reader may reach is freed before the matrix: a grown table, directory or row is published atomically
+  // and the one it replaced is kept (their sizes double, so that is less memory than the current ones take),
+  // the blocks are reused by the later epochs; so readers take no lock and announce themselves nowhere;
+  // a bounded matrix stops allocating blocks once their cells would exceed its size, the pairs that find no
+  // cell then are left to the table
+  class type_matrix
+  {
+  public:
+    type_matrix();
+    ~type_matrix();
+
+    type_matrix(const type_matrix&) = delete;
+    type_matrix& operator=(const type_matrix&) = delete;
+
+    // `epoch` is the one the caller loaded from the domain before consulting its table, see `cast_cache::current_epoch()`
+    [[nodiscard]] offset_type find(const void* const dynamic_key, const std::size_t column, const epoch_type epoch) const noexcept
+    {
+      const std::atomic<cell_type>* const cell = find_cell(dynamic_key, column);
+      if (cell == nullptr)
+        return missing_entry_offset;
+      const cell_type value = cell->load(std::memory_order_relaxed);
+      return (static_cast<epoch_type>(value >> 32) == epoch) ? static_cast<offset_type>(static_cast<std::uint32_t>(value))
+                                                             : missing_entry_offset;
+    }
+
+    // in cached_dynamic_cast.cpp, a store into an allocated cell takes no lock, an allocation does
+    void store(const void* dynamic_key, std::size_t column, epoch_type epoch, offset_type offset);
+    void set_max_size(std::size_t max_entry_count); // 0 means unbounded, frees nothing beyond it
+    [[nodiscard]] std::size_t bytes_used() const; // including what was replaced by grown parts
+
+  private:
+    static constexpr std::size_t block_size = 16; // two cache lines of cells
+    static constexpr std::size_t missing_dynamic_id = std::numeric_limits<std::size_t>::max();
+
+    using cell_type = std::uint64_t; // the epoch in the upper half, the offset in the lower one; 0: never stored
+
+    struct block
+    {
+      std::atomic<cell_type> cells[block_size]{};
+    };
+
+    struct row
+    {
+      explicit row(std::size_t block_count);
+
+      const std::size_t block_count;
+      const std::unique_ptr<std::atomic<block*>[]> blocks; // null where no column of the block was stored
+    };
+
+    struct row_directory
+    {
+      explicit row_directory(std::size_t size);
+
+      const std::size_t size;
+      const std::unique_ptr<std::atomic<row*>[]> rows; // indexed by the number of a dynamic key
+    };
+
+    struct dynamic_id_slot
+    {
+      std::atomic<const void*> dynamic_key{ nullptr }; // stored after `dynamic_id`
+      std::atomic<std::size_t> dynamic_id{ 0 };
+    };
+
+    struct dynamic_id_table
+    {
+      explicit dynamic_id_table(std::size_t size);
+
+      const std::size_t mask;
+      const std::unique_ptr<dynamic_id_slot[]> slots;
+    };
+
+    struct growth_state; // the lock, and everything ever allocated
+
+    [[nodiscard]] static std::size_t hash(const void* const dynamic_key) noexcept
+    {
+      return static_cast<std::size_t>((reinterpret_cast<std::uintptr_t>(dynamic_key) * 0x9E3779B97F4A7C15ull) >> 16);
+    }
+
+    [[nodiscard]] std::size_t find_dynamic_id(const void* const dynamic_key) const noexcept
+    {
+      const dynamic_id_table* const table = current_ids.load(std::memory_order_acquire);
+      if (table == nullptr)
+        return missing_dynamic_id;
+      for (std::size_t index = hash(dynamic_key) & table->mask; ; index = (index + 1) & table->mask)
+      {
+        const dynamic_id_slot& candidate = table->slots[index];
+        const void* const key = candidate.dynamic_key.load(std::memory_order_acquire);
+        if (key == dynamic_key)
+          return candidate.dynamic_id.load(std::memory_order_relaxed);
+        if (key == nullptr)
+          return missing_dynamic_id;
+      }
+    }
+
+    // the cell of `column` in the row of `dynamic_key`, null if it was never allocated; the directory and the row
+    // of a dynamic key are published before its number, so that they are found once the number is
+    [[nodiscard]] std::atomic<cell_type>* find_cell(const void* const dynamic_key, const std::size_t column) const noexcept
+    {
+      const std::size_t dynamic_id = find_dynamic_id(dynamic_key);
+      if (dynamic_id == missing_dynamic_id)
+        return nullptr;
+      const row_directory* const directory = current_directory.load(std::memory_order_acquire);
+      const row* const cells = directory->rows[dynamic_id].load(std::memory_order_acquire);
+      if (column / block_size >= cells->block_count)
+        return nullptr;
+      block* const cell_block = cells->blocks[column / block_size].load(std::memory_order_acquire);
+      return (cell_block != nullptr) ? &cell_block->cells[column % block_size] : nullptr;
+    }
+
+    [[nodiscard]] std::atomic<cell_type>* allocate_cell_locked(const void* dynamic_key, std::size_t column);
+    [[nodiscard]] std::size_t allocate_dynamic_id_locked(const void* dynamic_key);
+
+    std::atomic<const dynamic_id_table*> current_ids{ nullptr };
+    std::atomic<const row_directory*> current_directory{ nullptr };
+    std::atomic<bool> is_full{ false }; // set once the bound keeps further blocks from being allocated
+    const std::unique_ptr<growth_state> growth;
+  };
+
+  struct address_range
+  {
+    const void* begin;
+    const void* end; // not included
+  };
+
+  // in cached_dynamic_cast.cpp: the loaded segments of the module containing `address_in_module`, none if there is
+  // no such module (or no way to tell, without `dl_iterate_phdr()`)
+  [[nodiscard]] std::vector<address_range> module_address_ranges(const void* address_in_module);
+  [[nodiscard]] bool is_in_ranges(const void* address, const std::vector<address_range>& ranges) noexcept;
+} // namespace detail::cached_dynamic_cast_detail
+
+struct cached_dynamic_cast_global_cache_usage
+{
+  std::size_t entry_count;
+  std::size_t bytes_used; // heap memory taken by the table, including its empty slots
+  std::size_t capacity; // the maximum number of entries, 0 means unbounded
+};
+
+// a cache domain: a table shared by all threads, with its own locks, capacity and resets, so that unrelated
+// subsystems (or worker pools) neither contend with each other nor wipe each other's entries; pass it to
+// `cached_dynamic_cast(cache, ...)`, the free functions like `reset_cached_dynamic_cast_global_cache()`
+// work on `default_cast_cache()`; the thread-local cache in front of the tables is shared by all domains
+class cast_cache
+{
+  using offset_type = detail::cached_dynamic_cast_detail::offset_type;
+  using epoch_type = detail::cached_dynamic_cast_detail::epoch_type;
+  using cache_key = detail::cached_dynamic_cast_detail::cache_key;
+  using cache_entry = detail::cached_dynamic_cast_detail::cache_entry;
+
+public:
+  // `capacity`: 0 means unbounded, see `set_cached_dynamic_cast_global_cache_capacity()`;
+  // `upstream_memory` (which must outlive the domain) feeds the pools the slots of the tables are allocated from,
+  // so that a miss does not allocate in the steady state: only when a table grows beyond any earlier size
+  explicit cast_cache(std::size_t capacity = detail::cached_dynamic_cast_detail::global_cache_capacity,
+                      std::pmr::memory_resource* upstream_memory = std::pmr::get_default_resource());
+  ~cast_cache();
+
+  cast_cache(const cast_cache&) = delete;
+  cast_cache& operator=(const cast_cache&) = delete;
+
+  // the same as the free functions working on the default domain
+  void reset();
+  [[nodiscard]] cached_dynamic_cast_global_cache_usage usage() const;
+  void set_capacity(std::size_t capacity);
+  void compact();
+  std::size_t erase_address_range(const void* begin, const void* end);
+  std::size_t erase_module(const void* address_in_module);
+
+  // the rest is used by the casts: `current_epoch()` must be loaded before the table is consulted, so that
+  // an entry which raced with a reset is tagged with the old epoch and never gets used
+  [[nodiscard]] epoch_type current_epoch() const noexcept
+  {
+    return epoch.load(std::memory_order_acquire);
+  }
+
+  // returns an offset, `impossible_cast_offset` or `missing_entry_offset`
+  [[nodiscard]] offset_type find(const cache_key& key) const;
+  void store(const cache_key& key, offset_type offset);
+
+  // see `CACHED_DYNAMIC_CAST_TYPE_MATRIX`, `column` is a `dense_cast_id()`
+  [[nodiscard]] offset_type find_in_matrix(const void* const source_dynamic_key, const std::size_t column,
+                                           const epoch_type epoch) const
+  {
+    return matrix.find(source_dynamic_key, column, epoch);
+  }
+
+  void store_in_matrix(const void* const source_dynamic_key, const std::size_t column, const epoch_type epoch,
+                       const offset_type offset)
+  {
+    matrix.store(source_dynamic_key, column, epoch, offset);
+  }
+
+  // the matrix, then the table, whose hit is copied into the matrix (so that it recovers from a store which
+  // raced with a reset); out of line, so that the casts answered by the thread-local cache stay as short
+  [[nodiscard]] offset_type find_through_matrix(const cache_key& key, std::size_t column, epoch_type epoch);
+  void store_many(const cache_entry* entries, std::size_t count); // taking every lock once
+  [[nodiscard]] std::vector<cache_entry> copy_entries() const;
+
+private:
+  std::size_t erase_address_ranges(const std::vector<detail::cached_dynamic_cast_detail::address_range>& ranges);
+
+  std::atomic<epoch_type> epoch;
+  const std::unique_ptr<detail::cached_dynamic_cast_detail::cast_cache_storage> storage;
+  detail::cached_dynamic_cast_detail::type_matrix matrix; // empty unless `CACHED_DYNAMIC_CAST_TYPE_MATRIX`
+};
+
+namespace detail::cached_dynamic_cast_detail
+{
+  extern cast_cache default_cast_cache_instance; // in cached_dynamic_cast.cpp
+}
+
+// the domain used by all the casts that are not given one
+[[nodiscard]] inline cast_cache& default_cast_cache() noexcept
+{
+  return detail::cached_dynamic_cast_detail::default_cast_cache_instance;
+}
+
+namespace detail::cached_dynamic_cast_detail
+{
+  // the table of the default domain lives in cached_dynamic_cast.cpp, only the thread-local hit path is inlined;
+  // `find_in_global_cache()` returns an offset, `impossible_cast_offset` or `missing_entry_offset`
+  [[nodiscard]] inline offset_type find_in_global_cache(const cache_key& key)
+  {
+    return default_cast_cache().find(key);
+  }
+
+  inline void store_in_global_cache(const cache_key& key, const offset_type offset)
+  {
+    default_cast_cache().store(key, offset);
+  }
+
+  inline void store_many_in_global_cache(const cache_entry* const entries, const std::size_t count)
+  {
+    default_cast_cache().store_many(entries, count);
+  }
+
+  [[nodiscard]] inline std::vector<cache_entry> copy_global_cache_entries()
+  {
+    return default_cast_cache().copy_entries();
+  }
+
+  // `epoch` is the current epoch of the domain, see `cast_cache::current_epoch()`
+  [[nodiscard]] inline offset_type find_in_thread_local_cache(const cache_key& key, const epoch_type epoch) noexcept
+  {
+    if constexpr (thread_local_cache_size > 0)
+    {
+      const thread_local_cache_entry& slot = thread_local_cache_slot(key);
+      if (slot.epoch == epoch && same_key(slot.key, key))
+        return slot.offset;
+    }
+    return missing_entry_offset;
+  }
+
+  inline void store_in_thread_local_cache(const cache_key& key, const epoch_type epoch, const offset_type offset) noexcept
+  {
+    if constexpr (thread_local_cache_size > 0)
+      thread_local_cache_slot(key) = thread_local_cache_entry{ key, epoch, offset };
+  }
+
+  // `epoch` is the current epoch of `cache`, see `cast_cache::current_epoch()`
+  [[nodiscard]] inline offset_type find_offset(const cast_cache& cache, const cache_key& key, const epoch_type epoch)
+  {
+    if (const offset_type offset = find_in_thread_local_cache(key, epoch); offset != missing_entry_offset)
+      return offset;
+
+    const offset_type offset = cache.find(key);
+    if (offset != missing_entry_offset)
+      store_in_thread_local_cache(key, epoch, offset);
+    return offset;
+  }
+
+  inline void store_offset(cast_cache& cache, const cache_key& key, const epoch_type epoch, const offset_type offset)
+  {
+    cache.store(key, offset);
+    store_in_thread_local_cache(key, epoch, offset);
+  }
+
+  [[nodiscard]] inline offset_type offset_between(const volatile void* const destination_pointer,
+                                                  const volatile void* const source_pointer)
+  {
+    if (destination_pointer == nullptr)
+      return impossible_cast_offset;
+    return checked_cast_to_offset(static_cast<const volatile unsigned char*>(destination_pointer) -
+                                  static_cast<const volatile unsigned char*>(source_pointer));
+  }
+
+  inline constexpr int statistics_level = CACHED_DYNAMIC_CAST_STATISTICS;
+
+  enum class lookup_outcome { hit, negative_hit, miss };
+
+  // where `cached_dynamic_cast` was called from, if known
+  struct call_location
+  {
+    const char* file = nullptr;
+    unsigned line = 0;
+  };
+
+  // written only by the owning thread (so no read-modify-write is needed), read by `cached_dynamic_cast_stats()`;
+  // zero-initialized and trivially destructible, so accessing it involves no TLS wrapper call
+  struct thread_statistics_counters
+  {
+    std::atomic<std::uint64_t> hits;
+    std::atomic<std::uint64_t> negative_hits;
+    std::atomic<std::uint64_t> misses;
+    std::atomic<std::uint64_t> slow_path_nanoseconds;
+    std::atomic<std::uint64_t> writer_lock_wait_nanoseconds;
+    bool is_registered;
+  };
+
+  inline thread_local thread_statistics_counters thread_statistics;
+
+  // out of line, in cached_dynamic_cast.cpp
+  void register_thread_statistics();
+  void count_pair_lookup(const std::type_info& destination_type, const std::type_info& dynamic_type,
+                         const call_location& caller, lookup_outcome outcome, std::uint64_t count);
+
+  inline void add_to_thread_statistics(std::atomic<std::uint64_t> thread_statistics_counters::* const counter,
+                                       const std::uint64_t amount)
+  {
+    if (!thread_statistics.is_registered)
+      register_thread_statistics();
+    std::atomic<std::uint64_t>& value = thread_statistics.*counter;
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  template<typename SourceValue>
+  inline void count_lookup(const lookup_outcome outcome, const std::type_info& destination_type,
+                           SourceValue* const source_pointer, const call_location& caller, const std::uint64_t count = 1)
+  {
+    if constexpr (statistics_level > 0)
+    {
+      add_to_thread_statistics(outcome == lookup_outcome::hit          ? &thread_statistics_counters::hits
+                             : outcome == lookup_outcome::negative_hit ? &thread_statistics_counters::negative_hits
+                                                                       : &thread_statistics_counters::misses, count);
+      if constexpr (statistics_level > 1)
+        count_pair_lookup(destination_type, typeid(*source_pointer), caller, outcome, count);
+    }
+  }
+
+  // measures nothing and takes no space after optimization when the statistics are compiled out,
+  // unless `is_probe_enabled` (a probe reporting the duration is attached)
+  class statistics_stopwatch
+  {
+  public:
+    explicit statistics_stopwatch(const bool is_probe_enabled = false) noexcept
+      : is_measuring{ statistics_level > 0 || is_probe_enabled }
+    {
+      if (is_measuring)
+        start = std::chrono::steady_clock::now();
+    }
+
+    // 0 if not measuring
+    [[nodiscard]] std::uint64_t elapsed_nanoseconds() const
+    {
+      if (!is_measuring)
+        return 0;
+      return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // returns the amount added, for the probes
+    std::uint64_t add_elapsed_time_to(std::atomic<std::uint64_t> thread_statistics_counters::* const counter) const
+    {
+      const std::uint64_t elapsed = elapsed_nanoseconds();
+      if constexpr (statistics_level > 0)
+        add_to_thread_statistics(counter, elapsed);
+      return elapsed;
+    }
+
+  private:
+    bool is_measuring;
+    std::chrono::steady_clock::time_point start{};
+  };
+
+  // non-template part of `cached_dynamic_cast_call_site`: bookkeeping shared by all capacities
+  class call_site_cache_base
+  {
+  public:
+    call_site_cache_base(const char* file, unsigned line);
+    ~call_site_cache_base();
+
+    call_site_cache_base(const call_site_cache_base&) = delete;
+    call_site_cache_base& operator=(const call_site_cache_base&) = delete;
+
+  protected:
+    friend struct call_site_registry;
+
+    const char* const file;
+    const unsigned line;
+    call_site_cache_base* previous_in_registry{ nullptr };
+    call_site_cache_base* next_in_registry{ nullptr };
+
+    // seqlock: odd while the entries are being modified, readers retry through the slow path in that case
+    std::atomic<unsigned> version{ 0 };
+    std::atomic<epoch_type> epoch{ 0 };
+    std::atomic<unsigned> entry_count{ 0 };
+    std::atomic<bool> is_megamorphic{ false };
+
+    std::atomic<std::uint64_t> monomorphic_lookups{ 0 };
+    std::atomic<std::uint64_t> polymorphic_lookups{ 0 };
+    std::atomic<std::uint64_t> megamorphic_lookups{ 0 };
+    std::atomic<std::uint64_t> misses{ 0 };
+
+    void count_lookup(const unsigned current_entry_count) noexcept
+    {
+      if constexpr (CACHED_DYNAMIC_CAST_CALL_SITE_COUNTERS)
+      {
+        if (is_megamorphic.load(std::memory_order_relaxed))
+          megamorphic_lookups.fetch_add(1, std::memory_order_relaxed);
+        else if (current_entry_count <= 1)
+          monomorphic_lookups.fetch_add(1, std::memory_order_relaxed);
+        else
+          polymorphic_lookups.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    void count_miss() noexcept
+    {
+      if constexpr (CACHED_DYNAMIC_CAST_CALL_SITE_COUNTERS)
+        misses.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+} // namespace detail::cached_dynamic_cast_detail
+
+struct cached_dynamic_cast_call_site_statistics
+{
+  const char* file;
+  unsigned line;
+  std::size_t dynamic_types;  // number of (source DYNAMIC type -> result) pairs currently held by the call site
+  bool is_megamorphic;        // the call site has seen more dynamic types than it can hold
+  // the counters below are updated only if `CACHED_DYNAMIC_CAST_CALL_SITE_COUNTERS` is enabled
+  std::uint64_t monomorphic_lookups;
+  std::uint64_t polymorphic_lookups;
+  std::uint64_t megamorphic_lookups;
+  std::uint64_t misses; // lookups that had to fall back to the global cache
+};
+
+// statistics of all `cached_dynamic_cast_call_site` objects alive at the moment
+[[nodiscard]] std::vector<cached_dynamic_cast_call_site_statistics> collect_cached_dynamic_cast_call_site_statistics();
+
+// per-call-site polymorphic inline cache: remembers the results of casts from the last `Capacity` dynamic types
+// seen at one call site and only falls back to the global cache on a miss; meant to be a function-local static,
+// see `CACHED_DYNAMIC_CAST_AT_CALL_SITE()`
+template<std::size_t Capacity = 4>
+class cached_dynamic_cast_call_site final : private detail::cached_dynamic_cast_detail::call_site_cache_base
+{
+  static_assert(Capacity > 0);
+
+  using offset_type = detail::cached_dynamic_cast_detail::offset_type;
+  using epoch_type = detail::cached_dynamic_cast_detail::epoch_type;
+
+public:
+  cached_dynamic_cast_call_site(const char* file = "", unsigned line = 0)
+    : call_site_cache_base{ file, line }
+  {
+  }
+
+  // returns an offset, `impossible_cast_offset` or `missing_entry_offset`
+  [[nodiscard]] offset_type find(const void* const dynamic_type_key, const epoch_type current_epoch) noexcept
+  {
+    using detail::cached_dynamic_cast_detail::missing_entry_offset;
+
+    const unsigned version_before = version.load(std::memory_order_acquire);
+    if ((version_before & 1) == 0 && epoch.load(std::memory_order_relaxed) == current_epoch)
+    {
+      const unsigned current_entry_count = entry_count.load(std::memory_order_relaxed);
+      // acquire loads keep the final version check after the entry loads (plain loads on x86 and ARMv8)
+      for (unsigned i = 0; i < current_entry_count; ++i)
+      {
+        if (entries[i].key.load(std::memory_order_acquire) == dynamic_type_key)
+        {
+          const offset_type offset = entries[i].offset.load(std::memory_order_acquire);
+          if (version.load(std::memory_order_relaxed) != version_before)
+            break;
+          count_lookup(current_entry_count);
+          return offset;
+        }
+      }
+    }
+    count_miss();
+    return missing_entry_offset;
+  }
+
+  void store(const void* const dynamic_type_key, const epoch_type current_epoch, const offset_type offset) noexcept
+  {
+    unsigned current_version = version.load(std::memory_order_relaxed);
+    if ((current_version & 1) != 0
+     || !version.compare_exchange_strong(current_version, current_version + 1, std::memory_order_acquire))
+      return; // somebody else is updating the call site right now: not caching the result is okay
+
+    bool can_store = true;
+    if (epoch.load(std::memory_order_relaxed) != current_epoch)
+    {
+      // only a caller that has seen the latest epoch may wipe the entries; a stale caller just gives up
+      can_store = (current_epoch == default_cast_cache().current_epoch());
+      if (can_store)
+      {
+        entry_count.store(0, std::memory_order_relaxed);
+        is_megamorphic.store(false, std::memory_order_relaxed);
+        epoch.store(current_epoch, std::memory_order_relaxed);
+      }
+    }
+
+    if (can_store)
+    {
+      const unsigned current_entry_count = entry_count.load(std::memory_order_relaxed);
+      if (current_entry_count < Capacity)
+      {
+        entries[current_entry_count].key.store(dynamic_type_key, std::memory_order_release);
+        entries[current_entry_count].offset.store(offset, std::memory_order_release);
+        entry_count.store(current_entry_count + 1, std::memory_order_release);
+      }
+      else
+      {
+        is_megamorphic.store(true, std::memory_order_relaxed);
+      }
+    }
+
+    version.store(current_version + 2, std::memory_order_release);
+  }
+
+private:
+  struct entry
+  {
+    std::atomic<const void*> key{ nullptr };
+    std::atomic<offset_type> offset{ 0 };
+  };
+
+  entry entries[Capacity];
+};
+
+// cast through a per-call-site cache, creating a function-local static `cached_dynamic_cast_call_site`
+// (note: `DestinationPointer` must not contain unparenthesized commas)
+#define CACHED_DYNAMIC_CAST_AT_CALL_SITE(DestinationPointer, source_pointer) \
+  ([&]() -> DestinationPointer \
+   { \
+     static ::cached_dynamic_cast_call_site<> cached_dynamic_cast_call_site_instance{ __FILE__, __LINE__ }; \
+     return ::cached_dynamic_cast<DestinationPointer>(cached_dynamic_cast_call_site_instance, (source_pointer)); \
+   }())
+
+void reset_cached_dynamic_cast_global_cache();
+
+[[nodiscard]] cached_dynamic_cast_global_cache_usage get_cached_dynamic_cast_global_cache_usage();
+
+// 0 means unbounded; if the cache holds more entries than `capacity`, some of them are evicted right away
+// (entries stay valid in the thread-local caches, unlike after `reset_cached_dynamic_cast_global_cache()`)
+void set_cached_dynamic_cast_global_cache_capacity(std::size_t capacity);
+
+// releases the memory left over by evictions, a lowered capacity or a reset, keeping all the entries
+void compact_cached_dynamic_cast_global_cache();
+
+// removes the entries with a destination, static or dynamic type whose `type_info` (or vtable, with vtable keys)
+// lies in [begin, end), keeping all the other entries warm, unlike a reset; the table is scanned a few slots
+// at a time, so that no lookup waits for long; the thread-local and per-call-site caches are invalidated
+// as by a reset and refill from the table; returns the number of entries removed
+std::size_t erase_cached_dynamic_casts_in_address_range(const void* begin, const void* end);
+
+// the same for all the segments of the loaded shared object (or executable) containing `address_in_module`,
+// e.g. a function returned by `dlsym()`, to be called BEFORE `dlclose()`; the pair statistics naming
+// the types of the module and the classes it registered (see `CACHED_DYNAMIC_CAST_REGISTER_CLASS`) are dropped
+// as well; returns 0 without `dl_iterate_phdr()` to enumerate the modules
+std::size_t erase_cached_dynamic_casts_of_module(const void* address_in_module);
+
+struct cached_dynamic_cast_pair_statistics
+{
+  const char* destination_type; // `type_info::name()`
+  const char* dynamic_type; // `type_info::name()`
+  const char* file; // the caller (C++20 builds only), otherwise nullptr
+  unsigned line;
+  std::uint64_t hits;
+  std::uint64_t negative_hits;
+  std::uint64_t misses;
+};
+
+// totals over all threads, those that have finished included (all zeros unless CACHED_DYNAMIC_CAST_STATISTICS is set)
+struct cached_dynamic_cast_statistics
+{
+  std::uint64_t hits; // casts resolved by one of the caches
+  std::uint64_t negative_hits; // casts known to be impossible without calling `dynamic_cast`
+  std::uint64_t misses; // casts that had to call `dynamic_cast`
+  std::uint64_t slow_path_nanoseconds; // spent in `dynamic_cast` and storing its result
+  std::uint64_t writer_lock_wait_nanoseconds; // spent waiting for a lock to store a result
+  std::vector<cached_dynamic_cast_pair_statistics> pairs; // CACHED_DYNAMIC_CAST_STATISTICS >= 2 only, most used first
+
+  [[nodiscard]] std::string to_text() const;
+  [[nodiscard]] std::string to_json() const;
+};
+
+[[nodiscard]] cached_dynamic_cast_statistics cached_dynamic_cast_stats();
+
+// runs the warm-ups registered by `CACHED_DYNAMIC_CAST_PREWARM`, spread over `thread_count` threads
+// (1: on the calling thread only); meant for a startup hook, since neither the global cache nor the objects the
+// warm-ups read may exist yet during static initialization; may be called again, e.g. after `reset_cached_dynamic_cast_global_cache()`
+void prewarm_registered_cached_dynamic_casts(unsigned thread_count = 1);
+
+// persisted contents of the global cache, so that a restarted process skips the slow path for the pairs it knows:
+// entries are keyed by mangled type names and accepted only by a process with the same `build_id`, which must tell
+// the exact binaries apart (e.g. the build ID note of the executable); types with internal linkage are left out,
+// and so are the entries of type switches
+[[nodiscard]] std::vector<unsigned char> export_cached_dynamic_cast_snapshot(std::string_view build_id);
+bool export_cached_dynamic_cast_snapshot(const char* path, std::string_view build_id); // false if the file cannot be written
+
+// validates the snapshot and copies its entries aside (`data` is not used afterwards), every entry is copied into
+// the cache by the first miss of its pair, and all of them are kept until the snapshot is discarded or replaced;
+// returns false (ignoring the snapshot) if it cannot be read, is malformed or was written for another build
+bool import_cached_dynamic_cast_snapshot(const void* data, std::size_t size, std::string_view build_id);
+bool import_cached_dynamic_cast_snapshot(const char* path, std::string_view build_id); // reads the whole file
+void discard_imported_cached_dynamic_cast_snapshot();
+
+// registration of a hierarchy, so that successful casts between registered classes never call `dynamic_cast`
+// (not even on the first call) and never consult the table of a domain, only the thread-local cache in front of it:
+// a miss finds the dynamic type among the registered classes, whose table lists every registered ancestor
+// with a function adjusting a pointer to the complete object (found through the vtable) to that ancestor;
+//   CACHED_DYNAMIC_CAST_REGISTER_CLASS(A);          // at global scope, a root
+//   CACHED_DYNAMIC_CAST_REGISTER_CLASS(B, A);       // a class followed by its direct bases
+//   CACHED_DYNAMIC_CAST_REGISTER_CLASS(D, B, C);    // virtual bases and diamonds are fine
+//   CACHED_DYNAMIC_CAST_REGISTER_LEAF_CLASS(E, D);  // no class derives from E, as if it was `final`
+// the bases must be registered first; a cast to a class the registration does not list among the ancestors of the
+// dynamic type (an impossible cast, or one through a base that was not listed) takes the usual path, and so do
+// casts from or to classes that are not registered, to ancestors that are ambiguous or not public, and those made
+// during static initialization;
+// a module that registered classes must be erased (see `erase_cached_dynamic_casts_of_module()`) before unloading
+template<typename Class>
+struct cached_dynamic_cast_registered_class; // not defined: not registered
+
+namespace detail::cached_dynamic_cast_detail
+{
+  template<typename Class, typename = void>
+  struct is_registered_class : std::false_type
+  {
+  };
+
+  template<typename Class>
+  struct is_registered_class<Class, std::void_t<decltype(sizeof(cached_dynamic_cast_registered_class<Class>))>>
+    : std::true_type
+  {
+  };
+
+  template<typename Class>
+  inline constexpr bool is_registered_class_v = is_registered_class<Class>::value;
+
+  template<typename Class>
+  [[nodiscard]] constexpr bool is_registered_leaf_class() noexcept
+  {
+    if constexpr (is_registered_class_v<Class>)
+      return cached_dynamic_cast_registered_class<Class>::is_leaf;
+    else
+      return false;
+  }
+
+  template<typename... Types>
+  struct type_list
+  {
+  };
+
+  template<typename First, typename... Rest>
+  using first_type_t = First;
+
+  template<typename List, typename Type>
+  struct append_unique;
+
+  template<typename... Types, typename Type>
+  struct append_unique<type_list<Types...>, Type>
+  {
+    using type = std::conditional_t<(std::is_same_v<Types, Type> || ...), type_list<Types...>, type_list<Types..., Type>>;
+  };
+
+  // `List` followed by `Classes` and all their registered ancestors, each of them once
+  template<typename List, typename... Classes>
+  struct append_with_ancestors
+  {
+    using type = List;
+  };
+
+  template<typename List, typename Class, typename... Rest>
+  struct append_with_ancestors<List, Class, Rest...>
+  {
+    static_assert(is_registered_class_v<Class>, "the bases of a registered class must be registered before it");
+
+    template<typename Bases>
+    struct with_bases;
+
+    template<typename... Bases>
+    struct with_bases<type_list<Bases...>>
+    {
+      using type = typename append_with_ancestors<typename append_unique<List, Class>::type, Bases...>::type;
+    };
+
+    using type = typename append_with_ancestors<typename with_bases<typename cached_dynamic_cast_registered_class<Class>::bases>::type,
+                                                Rest...>::type;
+  };
+
+  using registered_adjustment = const volatile void* (*)(const volatile void* complete_object) noexcept;
+
+  template<typename Class, typename Ancestor>
+  [[nodiscard]] inline const volatile void* adjust_to_ancestor(const volatile void* const complete_object) noexcept
+  {
+    return static_cast<const volatile Ancestor*>(static_cast<const volatile Class*>(complete_object));
+  }
+
+  struct registered_ancestor
+  {
+    const std::type_info* type;
+    registered_adjustment adjustment; // nullptr if the ancestor is ambiguous or not public
+  };
+
+  struct registered_class_info
+  {
+    const std::type_info* type;
+    const registered_ancestor* ancestors; // the class itself included
+    std::size_t ancestor_count;
+
+    [[nodiscard]] const registered_ancestor* find_ancestor(const std::type_info& ancestor_type) const noexcept
+    {
+      for (const registered_ancestor* ancestor = ancestors; ancestor != ancestors + ancestor_count; ++ancestor)
+        if (*ancestor->type == ancestor_type)
+          return ancestor;
+      return nullptr;
+    }
+  };
+
+  // in cached_dynamic_cast.cpp: lookups take no lock, the classes are registered during static initialization
+  bool register_class(const registered_class_info& info);
+  [[nodiscard]] const registered_class_info* find_registered_class(const std::type_info& dynamic_type) noexcept;
+
+  template<typename Class, typename Ancestors>
+  struct registered_class_data;
+
+  template<typename Class, typename... Ancestors>
+  struct registered_class_data<Class, type_list<Ancestors...>>
+  {
+    static constexpr registered_ancestor ancestors[] = {
+      { &typeid(Ancestors),
+        std::is_convertible_v<Class*, Ancestors*> ? &adjust_to_ancestor<Class, Ancestors> : nullptr }... };
+    static constexpr registered_class_info info{ &typeid(Class), ancestors, sizeof...(Ancestors) };
+  };
+
+  // the base of the specializations made by the registration macros
+  template<bool IsLeaf, typename Class, typename... Bases>
+  struct registered_class_traits
+  {
+    static_assert(std::is_polymorphic_v<Class>);
+    static_assert((std::is_base_of_v<Bases, Class> && ...));
+
+    using bases = type_list<Bases...>;
+    static constexpr bool is_leaf = IsLeaf;
+
+    static bool register_at_startup()
+    {
+      using ancestors = typename append_with_ancestors<type_list<Class>, Bases...>::type;
+      return register_class(registered_class_data<Class, ancestors>::info);
+    }
+  };
+
+  // the offset of a cast between registered classes, `missing_entry_offset` if the registration cannot tell
+  template<typename DestinationValueNoCV, typename SourceValueNoCV, typename SourceValue>
+  [[nodiscard]] inline offset_type find_registered_offset(SourceValue* const source_pointer)
+  {
+    const registered_class_info* const dynamic_class = find_registered_class(typeid(*source_pointer));
+    if (dynamic_class == nullptr)
+      return missing_entry_offset;
+
+    // `dynamic_cast` fails if the source subobject is not a public base of the complete object
+    const registered_ancestor* const source_ancestor = dynamic_class->find_ancestor(typeid(SourceValueNoCV));
+    if (source_ancestor == nullptr || source_ancestor->adjustment == nullptr)
+      return missing_entry_offset;
+
+    // a destination missing from the ancestors may still be reached through a base that was not listed,
+    // so only `dynamic_cast` can tell that the cast is impossible
+    const registered_ancestor* const destination_ancestor = dynamic_class->find_ancestor(typeid(DestinationValueNoCV));
+    if (destination_ancestor == nullptr || destination_ancestor->adjustment == nullptr)
+      return missing_entry_offset;
+
+    // reads the offset to the complete object from the vtable, without searching the hierarchy
+    const volatile void* const complete_object = dynamic_cast<const volatile void*>(source_pointer);
+    return offset_between(destination_ancestor->adjustment(complete_object), source_pointer);
+  }
+} // namespace detail::cached_dynamic_cast_detail
+
+#define CACHED_DYNAMIC_CAST_DETAIL_REGISTER_CLASS(is_leaf_class, ...) \
+  template<> \
+  struct cached_dynamic_cast_registered_class<::detail::cached_dynamic_cast_detail::first_type_t<__VA_ARGS__>> \
+    : ::detail::cached_dynamic_cast_detail::registered_class_traits<is_leaf_class, __VA_ARGS__> \
+  { \
+    inline static const bool is_registered_at_startup = \
+      ::detail::cached_dynamic_cast_detail::registered_class_traits<is_leaf_class, __VA_ARGS__>::register_at_startup(); \
+  }
+
+#define CACHED_DYNAMIC_CAST_REGISTER_CLASS(...) CACHED_DYNAMIC_CAST_DETAIL_REGISTER_CLASS(false, __VA_ARGS__)
+#define CACHED_DYNAMIC_CAST_REGISTER_LEAF_CLASS(...) CACHED_DYNAMIC_CAST_DETAIL_REGISTER_CLASS(true, __VA_ARGS__)
+
+namespace detail::cached_dynamic_cast_detail
+{
+  // an entry of an `intrusive_key_row`: the offset of the source subobject from the complete object in the upper
+  // half, the offset of the result (or `impossible_cast_offset`) in the lower one, read by a single load; a class
+  // may contain several subobjects of the source type, and the result of a cast depends on which one is given
+  using intrusive_row_entry = std::uint64_t;
+
+  [[nodiscard]] constexpr intrusive_row_entry make_intrusive_row_entry(const offset_type source_offset,
+                                                                       const offset_type destination_offset) noexcept
+  {
+    return (intrusive_row_entry{ static_cast<std::uint32_t>(source_offset) } << 32) | static_cast<std::uint32_t>(destination_offset);
+  }
+
+  // the part of an `intrusive_key_row` readers load
+  struct intrusive_cast_row_storage
+  {
+    explicit intrusive_cast_row_storage(const std::size_t size)
+      : size{ size }
+      , entries{ std::make_unique<std::atomic<intrusive_row_entry>[]>(size) }
+    {
+      for (std::size_t index = 0; index < size; ++index)
+        entries[index].store(make_intrusive_row_entry(0, missing_entry_offset), std::memory_order_relaxed);
+    }
+
+    const std::size_t size;
+    const std::unique_ptr<std::atomic<intrusive_row_entry>[]> entries;
+  };
+
+  // the results of the casts from the objects with one `dynamic_type_key()`, indexed by `dense_cast_id()`;
+  // it only grows (the storage it outgrows is kept, readers may still be using it) and is never reset
+  struct intrusive_key_row
+  {
+    const void* const dynamic_key;
+    std::atomic<intrusive_cast_row_storage*> storage{ nullptr };
+    std::atomic<intrusive_key_row*> next{ nullptr }; // the row of another dynamic key of the same class
+
+    // the offset of the result from the complete object, `impossible_cast_offset` or `missing_entry_offset`
+    [[nodiscard]] offset_type find(const std::size_t cast_id, const offset_type source_offset) const noexcept
+    {
+      const intrusive_cast_row_storage* const current = storage.load(std::memory_order_acquire);
+      if (current == nullptr || cast_id >= current->size)
+        return missing_entry_offset;
+      const intrusive_row_entry entry = current->entries[cast_id].load(std::memory_order_relaxed);
+      if ((entry >> 32) != static_cast<std::uint32_t>(source_offset))
+        return missing_entry_offset; // stored for another subobject of the source type, or not at all
+      return static_cast<offset_type>(static_cast<std::uint32_t>(entry));
+    }
+  };
+
+  // the rows of one class: while an object is constructed or destroyed as a base of a class with virtual bases,
+  // it reports the row of its own class, but its virtual bases lie where the complete class puts them; such
+  // an object has a vtable of its own (a construction vtable), so every dynamic key gets a row of its own,
+  // whichever of them is seen first; the rows are listed in the order of their creation and never removed
+  struct intrusive_cast_row
+  {
+    const std::type_info* const type;
+    std::atomic<intrusive_key_row*> first_key_row{ nullptr };
+
+    [[nodiscard]] intrusive_key_row* find_key_row(const void* const dynamic_key) const noexcept
+    {
+      intrusive_key_row* key_row = first_key_row.load(std::memory_order_acquire);
+      while (key_row != nullptr && key_row->dynamic_key != dynamic_key)
+        key_row = key_row->next.load(std::memory_order_acquire);
+      return key_row;
+    }
+  };
+
+  // what the dynamic type of an object reports about itself, see `cached_dynamic_cast_intrusive_root`
+  struct intrusive_row_reference
+  {
+    intrusive_cast_row* row;
+    const volatile void* complete_object;
+    const void* dynamic_key; // that of `complete_object`, selects an `intrusive_key_row` of `row`
+  };
+
+  // in cached_dynamic_cast.cpp: storing into an existing slot takes no lock, adding or growing a row does
+  void store_in_intrusive_row(intrusive_cast_row& row, const void* dynamic_key, std::size_t cast_id, intrusive_row_entry entry);
+
+  template<typename Class>
+  [[nodiscard]] inline intrusive_cast_row& intrusive_row_of() noexcept
+  {
+    static intrusive_cast_row row{ &typeid(Class) };
+    return row;
+  }
+} // namespace detail::cached_dynamic_cast_detail
+
+// opt-in for own hierarchies: a cast from a class publicly derived from `cached_dynamic_cast_intrusive_root`
+// looks its result up in a row of offsets that the dynamic type of the object hands out through a virtual call,
+// indexed by a dense number given to the pair of the source and destination types on its first use: no hashing, no locks, no table of
+// a domain (nor the thread-local cache in front of it); every class of such a hierarchy declares its own row,
+// either through the CRTP base
+//   class Shape : public cached_dynamic_cast_intrusive<Shape> { ... };
+//   class Circle : public cached_dynamic_cast_intrusive<Circle, Shape> { ... }; // inherits the constructors of Shape
+// or, for example with several bases, through a macro in its body
+//   class Widget : public Circle, public Observer { CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(Widget); ... };
+// the objects of a class that declares no row of its own take the usual path; the rows are never reset;
+// without `CACHED_DYNAMIC_CAST_USE_VPTR_KEYS`, the rows are not used at all and every cast takes the usual path
+class cached_dynamic_cast_intrusive_root
+{
+public:
+  [[nodiscard]] virtual detail::cached_dynamic_cast_detail::intrusive_row_reference
+  cached_dynamic_cast_row() const volatile noexcept = 0;
+
+protected:
+  ~cached_dynamic_cast_intrusive_root() = default;
+};
+
+#define CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(Class) \
+  [[nodiscard]] ::detail::cached_dynamic_cast_detail::intrusive_row_reference \
+  cached_dynamic_cast_row() const volatile noexcept override \
+  { \
+    return { &::detail::cached_dynamic_cast_detail::intrusive_row_of<Class>(), static_cast<const volatile Class*>(this), \
+             ::detail::cached_dynamic_cast_detail::dynamic_type_key(static_cast<const volatile Class*>(this)) }; \
+  } \
+  using cached_dynamic_cast_intrusive_class = Class
+
+template<typename Class, typename Base = cached_dynamic_cast_intrusive_root>
+class cached_dynamic_cast_intrusive : public Base
+{
+public:
+  using Base::Base;
+
+  CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(Class);
+};
+
+namespace detail::cached_dynamic_cast_detail
+{
+  template<typename DestinationPointer, typename SourcePointer>
+  [[nodiscard]] inline DestinationPointer apply_offset(SourcePointer const source_pointer, const offset_type offset) noexcept
+  {
+    using DestinationValueNoCV = std::remove_cv_t<std::remove_pointer_t<DestinationPointer>>;
+    return const_cast<DestinationPointer>(
+      reinterpret_cast<const volatile DestinationValueNoCV*>(
+        reinterpret_cast<const volatile unsigned char*>(source_pointer) + offset));
+  }
+
+  template<typename SourceValueNoCV>
+  inline constexpr bool is_intrusive_source_v =
+    std::is_convertible_v<const volatile SourceValueNoCV*, const volatile cached_dynamic_cast_intrusive_root*>;
+
+  // only a vtable pointer tells an object under construction as a base of a class with virtual bases from
+  // a complete object of its class, so with `type_info` keys the casts from opted-in classes take the usual path
+  inline constexpr bool intrusive_rows_enabled = CACHED_DYNAMIC_CAST_USE_VPTR_KEYS != 0;
+
+  template<typename SourceValueNoCV>
+  inline constexpr bool uses_intrusive_row_v = intrusive_rows_enabled && is_intrusive_source_v<SourceValueNoCV>;
+
+  // the row is that of an ancestor if the dynamic type of the object does not declare its own
+  template<typename SourceValue>
+  [[nodiscard]] inline bool is_own_intrusive_row(const intrusive_row_reference& reference,
+                                                 SourceValue* const source_pointer) noexcept
+  {
+    return reference.row->type == &typeid(*source_pointer);
+  }
+
+  template<typename DestinationPointer, typename SourcePointer>
+  [[nodiscard]] inline DestinationPointer cast_through_intrusive_row(const intrusive_row_reference& reference,
+                                                                     SourcePointer const source_pointer,
+                                                                     const call_location& caller)
+  {
+    using SourceValueNoCV = std::remove_cv_t<std::remove_pointer_t<SourcePointer>>;
+    using DestinationValueNoCV = std::remove_cv_t<std::remove_pointer_t<DestinationPointer>>;
+
+    const std::type_info& destination_type = typeid(DestinationValueNoCV);
+    const std::size_t cast_id = dense_cast_id<SourceValueNoCV, DestinationValueNoCV>();
+    const offset_type source_offset = offset_between(source_pointer, reference.complete_object);
+
+    const intrusive_key_row* const key_row = reference.row->find_key_row(reference.dynamic_key);
+    const offset_type offset = (key_row != nullptr) ? key_row->find(cast_id, source_offset) : missing_entry_offset;
+    if (offset == impossible_cast_offset)
+    {
+      count_lookup(lookup_outcome::negative_hit, destination_type, source_pointer, caller);
+      return nullptr;
+    }
+    if (offset != missing_entry_offset)
+    {
+      count_lookup(lookup_outcome::hit, destination_type, source_pointer, caller);
+      return apply_offset<DestinationPointer>(reference.complete_object, offset);
+    }
+
+    if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_entry))
+      fire_slow_path_entry_probe(destination_type, typeid(*source_pointer));
+    const statistics_stopwatch slow_path_stopwatch{ CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit) };
+    DestinationPointer const destination_pointer = dynamic_cast<DestinationPointer>(source_pointer);
+    const std::uint64_t dynamic_cast_nanoseconds =
+      CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit) ? slow_path_stopwatch.elapsed_nanoseconds() : 0;
+    store_in_intrusive_row(*reference.row, reference.dynamic_key, cast_id,
+                           make_intrusive_row_entry(source_offset, offset_between(destination_pointer, reference.complete_object)));
+    slow_path_stopwatch.add_elapsed_time_to(&thread_statistics_counters::slow_path_nanoseconds);
+    count_lookup(lookup_outcome::miss, destination_type, source_pointer, caller);
+    if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit))
+      fire_slow_path_exit_probe(destination_type, typeid(*source_pointer), dynamic_cast_nanoseconds,
+                                destination_pointer != nullptr);
+    return destination_pointer;
+  }
+
+  // consults the thread-local cache and the table of `cache`, falls back to `dynamic_cast`;
+  // `source_pointer` must not be null, the types must have been checked by the caller
+  template<typename DestinationPointer, typename SourcePointer>
+  [[nodiscard]] inline DestinationPointer cast_through_global_cache(cast_cache& cache, SourcePointer const source_pointer,
+                                                                    const call_location& caller = {})
+  {
+    using SourceValueNoCV = std::remove_cv_t<std::remove_pointer_t<SourcePointer>>;
+    using DestinationValueNoCV = std::remove_cv_t<std::remove_pointer_t<DestinationPointer>>;
+
+    const std::type_info& destination_type = typeid(DestinationValueNoCV);
+
+    // shortcut for casting to a `final` class or to a registered leaf class
+    if constexpr (std::is_final_v<DestinationValueNoCV> || is_registered_leaf_class<DestinationValueNoCV>())
+    {
+      if (typeid(*source_pointer) != destination_type)
+      {
+        count_lookup(lookup_outcome::negative_hit, destination_type, source_pointer, caller);
+        return nullptr;
+      }
+    }
+
+    // a registered leaf is the complete object, and the source an unambiguous public base of it
+    if constexpr (is_registered_leaf_class<DestinationValueNoCV>() && std::is_convertible_v<DestinationValueNoCV*, SourceValueNoCV*>)
+    {
+      count_lookup(lookup_outcome::hit, destination_type, source_pointer, caller);
+      return const_cast<DestinationPointer>(static_cast<const volatile DestinationValueNoCV*>(
+        dynamic_cast<const volatile void*>(source_pointer)));
+    }
+
+    // an opted-in source (see `cached_dynamic_cast_intrusive_root`) uses the row of its dynamic type instead
+    if constexpr (uses_intrusive_row_v<SourceValueNoCV>)
+    {
+      const volatile cached_dynamic_cast_intrusive_root* const root = source_pointer;
+      const intrusive_row_reference reference = root->cached_dynamic_cast_row();
+      if (is_own_intrusive_row(reference, source_pointer))
+        return cast_through_intrusive_row<DestinationPointer>(reference, source_pointer, caller);
+    }
+
+    const std::type_info& source_static_type = typeid(SourceValueNoCV);
+
+    const cache_key key{ &destination_type, dynamic_type_key(source_pointer), &source_static_type };
+    const epoch_type epoch = cache.current_epoch();
+
+    // casts between registered classes skip the table of `cache`
+    if constexpr (is_registered_class_v<SourceValueNoCV> && is_registered_class_v<DestinationValueNoCV>)
+    {
+      offset_type registered_offset = find_in_thread_local_cache(key, epoch);
+      if (registered_offset == missing_entry_offset)
+      {
+        registered_offset = find_registered_offset<DestinationValueNoCV, SourceValueNoCV>(source_pointer);
+        if (registered_offset != missing_entry_offset)
+          store_in_thread_local_cache(key, epoch, registered_offset);
+      }
+      if (registered_offset == impossible_cast_offset)
+      {
+        count_lookup(lookup_outcome::negative_hit, destination_type, source_pointer, caller);
+        return nullptr;
+      }
+      if (registered_offset != missing_entry_offset)
+      {
+        count_lookup(lookup_outcome::hit, destination_type, source_pointer, caller);
+        return apply_offset<DestinationPointer>(source_pointer, registered_offset);
+      }
+    }
+
+    // the matrix of `cache` sits between the thread-local cache and the table, the column is only numbered past
+    // the thread-local cache
+    offset_type cached_offset = find_in_thread_local_cache(key, epoch);
+    if (cached_offset == missing_entry_offset)
+    {
+      if constexpr (type_matrix_enabled)
+        cached_offset = cache.find_through_matrix(key, dense_cast_id<SourceValueNoCV, DestinationValueNoCV>(), epoch);
+      else
+        cached_offset = cache.find(key);
+      if (cached_offset != missing_entry_offset)
+        store_in_thread_local_cache(key, epoch, cached_offset);
+    }
+    if (cached_offset == impossible_cast_offset)
+    {
+      count_lookup(lookup_outcome::negative_hit, destination_type, source_pointer, caller);
+      return nullptr;
+    }
+    if (cached_offset != missing_entry_offset)
+    {
+      count_lookup(lookup_outcome::hit, destination_type, source_pointer, caller);
+      return apply_offset<DestinationPointer>(source_pointer, cached_offset);
+    }
+
+    // entries of an imported snapshot are resolved lazily, once an object of their dynamic type shows up
+    if (has_imported_snapshot.load(std::memory_order_acquire))
+    {
+      const offset_type imported_offset = find_in_imported_snapshot(key, typeid(*source_pointer));
+      if (imported_offset != missing_entry_offset)
+      {
+        store_offset(cache, key, epoch, imported_offset);
+        if constexpr (type_matrix_enabled)
+          cache.store_in_matrix(key.source_dynamic_key, dense_cast_id<SourceValueNoCV, DestinationValueNoCV>(), epoch, imported_offset);
+        if (imported_offset == impossible_cast_offset)
+        {
+          count_lookup(lookup_outcome::negative_hit, destination_type, source_pointer, caller);
+          return nullptr;
+        }
+        count_lookup(lookup_outcome::hit, destination_type, source_pointer, caller);
+        return apply_offset<DestinationPointer>(source_pointer, imported_offset);
+      }
+    }
+
+    // if reached this line, there is no entry about the attempted cast in the cache (yet):
+    // perform a standard C++ dynamic_cast, then add an entry about its result to the cache
+    if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_entry))
+      fire_slow_path_entry_probe(destination_type, typeid(*source_pointer));
+    const statistics_stopwatch slow_path_stopwatch{ CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit) };
+    DestinationPointer const destination_pointer = dynamic_cast<DestinationPointer>(source_pointer);
+    const std::uint64_t dynamic_cast_nanoseconds =
+      CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit) ? slow_path_stopwatch.elapsed_nanoseconds() : 0;
+    const offset_type offset = offset_between(destination_pointer, source_pointer);
+    store_offset(cache, key, epoch, offset);
+    if constexpr (type_matrix_enabled)
+      cache.store_in_matrix(key.source_dynamic_key, dense_cast_id<SourceValueNoCV, DestinationValueNoCV>(), epoch, offset);
+    slow_path_stopwatch.add_elapsed_time_to(&thread_statistics_counters::slow_path_nanoseconds);
+    count_lookup(lookup_outcome::miss, destination_type, source_pointer, caller);
+    if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit))
+      fire_slow_path_exit_probe(destination_type, typeid(*source_pointer), dynamic_cast_nanoseconds,
+                                destination_pointer != nullptr);
+    return destination_pointer;
+  }
+
+  // consults `call_site` first, then `cast_through_global_cache()` of the default domain
+  template<typename DestinationPointer, std::size_t Capacity, typename SourcePointer>
+  [[nodiscard]] inline DestinationPointer cast_through_call_site(cached_dynamic_cast_call_site<Capacity>& call_site,
+                                                                SourcePointer const source_pointer,
+                                                                const call_location& caller = {})
+  {
+    using DestinationValueNoCV = std::remove_cv_t<std::remove_pointer_t<DestinationPointer>>;
+
+    const void* const key = dynamic_type_key(source_pointer);
+    const epoch_type epoch = default_cast_cache().current_epoch();
+
+    const offset_type cached_offset = call_site.find(key, epoch);
+    if (cached_offset == impossible_cast_offset)
+    {
+      count_lookup(lookup_outcome::negative_hit, typeid(DestinationValueNoCV), source_pointer, caller);
+      return nullptr;
+    }
+    if (cached_offset != missing_entry_offset)
+    {
+      count_lookup(lookup_outcome::hit, typeid(DestinationValueNoCV), source_pointer, caller);
+      return apply_offset<DestinationPointer>(source_pointer, cached_offset);
+    }
+
+    DestinationPointer const destination_pointer = cast_through_global_cache<DestinationPointer>(default_cast_cache(),
+                                                                                                source_pointer, caller);
+    call_site.store(key, epoch, offset_between(destination_pointer, source_pointer));
+    return destination_pointer;
+  }
+
+  template<typename DestinationValueNoCV, typename SourceValueNoCV>
+  struct per_instantiation_cache_tag
+  {
+  };
+
+  // the table owned by one (destination STATIC type, source STATIC type) pair, keyed by the source DYNAMIC type only;
+  // it is registered along with the call sites, so it shows up in their statistics and follows resets
+  template<typename DestinationValueNoCV, typename SourceValueNoCV>
+  [[nodiscard]] inline cached_dynamic_cast_call_site<per_instantiation_cache_size>& per_instantiation_cache()
+  {
+    static cached_dynamic_cast_call_site<per_instantiation_cache_size> cache{
+      typeid(per_instantiation_cache_tag<DestinationValueNoCV, SourceValueNoCV>).name() };
+    return cache;
+  }
+} // namespace detail::cached_dynamic_cast_detail
+
+// primary template: cast from a pointer type to a pointer type
+template<typename DestinationPointer, typename SourcePointer>
+[[nodiscard]] inline std::enable_if_t<std::is_pointer_v<DestinationPointer>, DestinationPointer>
+cached_dynamic_cast(SourcePointer const source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  static_assert(std::is_pointer_v<SourcePointer>); // casting to a pointer type is allowed from a pointer type only
+
+  using SourceValue = std::remove_pointer_t<SourcePointer>;
+  using DestinationValue = std::remove_pointer_t<DestinationPointer>;
+
+  // adding cv-qualifiers is okay, but removing them is not
+  static_assert(static_cast<int>(std::is_const_v<DestinationValue>)
+             >= static_cast<int>(std::is_const_v<SourceValue>));
+  static_assert(static_cast<int>(std::is_volatile_v<DestinationValue>)
+             >= static_cast<int>(std::is_volatile_v<SourceValue>));
+
+  using SourceValueNoCV = std::remove_cv_t<SourceValue>;
+  using DestinationValueNoCV = std::remove_cv_t<DestinationValue>;
+
+  // casting is supported for polymorphic class types only (at least for now)
+  static_assert(std::is_polymorphic_v<SourceValueNoCV>);
+  static_assert(std::is_polymorphic_v<DestinationValueNoCV>);
+
+  // don't waste time if the types are actually the same
+  // or if the source type is publicly derived from the destination type
+  if constexpr (std::is_base_of_v<DestinationValueNoCV, SourceValueNoCV>
+             && std::is_convertible_v<SourceValueNoCV*, DestinationValueNoCV*>)
+    return source_pointer;
+
+  // filter out the case where the client attempts to cast from a null pointer
+  if (source_pointer == nullptr)
+    return nullptr;
+
+  using namespace detail::cached_dynamic_cast_detail;
+  if constexpr (per_instantiation_cache_size > 0 && !uses_intrusive_row_v<SourceValueNoCV>)
+    return cast_through_call_site<DestinationPointer>(per_instantiation_cache<DestinationValueNoCV, SourceValueNoCV>(),
+                                                      source_pointer, CACHED_DYNAMIC_CAST_DETAIL_CALLER);
+  else
+    return cast_through_global_cache<DestinationPointer>(default_cast_cache(), source_pointer, CACHED_DYNAMIC_CAST_DETAIL_CALLER);
+}
+
+// cast from a pointer type to a pointer type through the given cache domain
+// (bypassing the per-instantiation tables, which belong to the default domain)
+template<typename DestinationPointer, typename SourcePointer>
+[[nodiscard]] inline std::enable_if_t<std::is_pointer_v<DestinationPointer>, DestinationPointer>
+cached_dynamic_cast(cast_cache& cache, SourcePointer const source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  static_assert(std::is_pointer_v<SourcePointer>); // casting to a pointer type is allowed from a pointer type only
+
+  using SourceValueNoCV = std::remove_cv_t<std::remove_pointer_t<SourcePointer>>;
+  using DestinationValueNoCV = std::remove_cv_t<std::remove_pointer_t<DestinationPointer>>;
+
+  // nothing to cache for upcasts and null pointers: let the primary template handle them
+  if constexpr (std::is_base_of_v<DestinationValueNoCV, SourceValueNoCV>
+             && std::is_convertible_v<SourceValueNoCV*, DestinationValueNoCV*>)
+    return cached_dynamic_cast<DestinationPointer>(source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+
+  if (source_pointer == nullptr)
+    return cached_dynamic_cast<DestinationPointer>(source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+
+  return detail::cached_dynamic_cast_detail::cast_through_global_cache<DestinationPointer>(cache, source_pointer,
+                                                                                         CACHED_DYNAMIC_CAST_DETAIL_CALLER);
+}
+
+// cast from a pointer type to a pointer type, first consulting the given per-call-site cache
+template<typename DestinationPointer, std::size_t Capacity, typename SourcePointer>
+[[nodiscard]] inline std::enable_if_t<std::is_pointer_v<DestinationPointer>, DestinationPointer>
+cached_dynamic_cast(cached_dynamic_cast_call_site<Capacity>& call_site, SourcePointer const source_pointer
+                    CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  static_assert(std::is_pointer_v<SourcePointer>); // casting to a pointer type is allowed from a pointer type only
+
+  using SourceValueNoCV = std::remove_cv_t<std::remove_pointer_t<SourcePointer>>;
+  using DestinationValueNoCV = std::remove_cv_t<std::remove_pointer_t<DestinationPointer>>;
+
+  // nothing to cache for upcasts and null pointers: let the primary template handle them
+  if constexpr (std::is_base_of_v<DestinationValueNoCV, SourceValueNoCV>
+             && std::is_convertible_v<SourceValueNoCV*, DestinationValueNoCV*>)
+    return cached_dynamic_cast<DestinationPointer>(source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+
+  if (source_pointer == nullptr)
+    return cached_dynamic_cast<DestinationPointer>(source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+
+  return detail::cached_dynamic_cast_detail::cast_through_call_site<DestinationPointer>(call_site, source_pointer,
+                                                                                      CACHED_DYNAMIC_CAST_DETAIL_CALLER);
+}
+
+// cast from a reference type to a reference type
+template<typename DestinationReference, typename SourceValue>
+[[nodiscard]] inline std::enable_if_t<std::is_reference_v<DestinationReference>, DestinationReference>
+cached_dynamic_cast(SourceValue& source_reference CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  static_assert(!std::is_pointer_v<SourceValue>); // casting from a reference to a pointer... what?
+  static_assert(!std::is_rvalue_reference_v<DestinationReference>); // casting to an rvalue reference is not allowed
+
+  using DestinationValue = std::remove_reference_t<DestinationReference>;
+  static_assert(!std::is_pointer_v<DestinationValue>); // casting to a reference to a pointer... what??? :)
+
+  DestinationValue* destination_pointer = cached_dynamic_cast<DestinationValue*>(std::addressof(source_reference)
+                                                                                CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  if (destination_pointer != nullptr)
+    return *destination_pointer;
+  else
+    throw std::bad_cast{};
+}
+
+// cast from a reference type to a reference type through the given cache domain
+template<typename DestinationReference, typename SourceValue>
+[[nodiscard]] inline std::enable_if_t<std::is_reference_v<DestinationReference>, DestinationReference>
+cached_dynamic_cast(cast_cache& cache, SourceValue& source_reference CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  static_assert(!std::is_pointer_v<SourceValue>); // casting from a reference to a pointer... what?
+  static_assert(!std::is_rvalue_reference_v<DestinationReference>); // casting to an rvalue reference is not allowed
+
+  using DestinationValue = std::remove_reference_t<DestinationReference>;
+  static_assert(!std::is_pointer_v<DestinationValue>); // casting to a reference to a pointer... what??? :)
+
+  DestinationValue* destination_pointer = cached_dynamic_cast<DestinationValue*>(cache, std::addressof(source_reference)
+                                                                                CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  if (destination_pointer != nullptr)
+    return *destination_pointer;
+  else
+    throw std::bad_cast{};
+}
+
+// cast from an lvalue `std::shared_ptr` to a `std::shared_ptr`
+template<typename DestinationValue, typename SourceValue>
+[[nodiscard]] inline std::shared_ptr<DestinationValue>
+cached_dynamic_pointer_cast(const std::shared_ptr<SourceValue>& source_shared_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  auto* result = cached_dynamic_cast<typename std::shared_ptr<DestinationValue>::element_type*>(source_shared_pointer.get()
+                                                                                              CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  if (result)
+    return std::shared_ptr<DestinationValue>{source_shared_pointer, result};
+  else
+    return {};
+}
+
+// cast from an rvalue `std::shared_ptr` to a `std::shared_ptr`
+template<typename DestinationValue, typename SourceValue>
+[[nodiscard]] inline std::shared_ptr<DestinationValue>
+cached_dynamic_pointer_cast(std::shared_ptr<SourceValue>&& source_shared_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  auto* result = cached_dynamic_cast<typename std::shared_ptr<DestinationValue>::element_type*>(source_shared_pointer.get()
+                                                                                              CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  if (result)
+    return std::shared_ptr<DestinationValue>{std::move(source_shared_pointer), result};
+  else
+    return {};
+}
+
+// cast from an lvalue `std::shared_ptr` to a `std::shared_ptr` through the given cache domain
+template<typename DestinationValue, typename SourceValue>
+[[nodiscard]] inline std::shared_ptr<DestinationValue>
+cached_dynamic_pointer_cast(cast_cache& cache, const std::shared_ptr<SourceValue>& source_shared_pointer
+                            CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  auto* result = cached_dynamic_cast<typename std::shared_ptr<DestinationValue>::element_type*>(cache, source_shared_pointer.get()
+                                                                                              CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  if (result)
+    return std::shared_ptr<DestinationValue>{source_shared_pointer, result};
+  else
+    return {};
+}
+
+// cast from an rvalue `std::shared_ptr` to a `std::shared_ptr` through the given cache domain
+template<typename DestinationValue, typename SourceValue>
+[[nodiscard]] inline std::shared_ptr<DestinationValue>
+cached_dynamic_pointer_cast(cast_cache& cache, std::shared_ptr<SourceValue>&& source_shared_pointer
+                            CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  auto* result = cached_dynamic_cast<typename std::shared_ptr<DestinationValue>::element_type*>(cache, source_shared_pointer.get()
+                                                                                              CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  if (result)
+    return std::shared_ptr<DestinationValue>{std::move(source_shared_pointer), result};
+  else
+    return {};
+}
+
+// cast from a `std::shared_ptr` to a plain pointer, for callers that only inspect the result:
+// no reference count is touched, the result is valid as long as the object is owned by someone
+template<typename DestinationValue, typename SourceValue>
+[[nodiscard]] inline DestinationValue*
+cached_dynamic_observer_cast(const std::shared_ptr<SourceValue>& source_shared_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  return cached_dynamic_cast<DestinationValue*>(source_shared_pointer.get() CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+}
+
+// cast from a `std::weak_ptr` to a `std::shared_ptr`: locks it, the reference taken by the lock is moved to the result
+template<typename DestinationValue, typename SourceValue>
+[[nodiscard]] inline std::shared_ptr<DestinationValue>
+cached_dynamic_pointer_cast(const std::weak_ptr<SourceValue>& source_weak_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  return cached_dynamic_pointer_cast<DestinationValue>(source_weak_pointer.lock() CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+}
 
 namespace detail::cached_dynamic_cast_detail
 {
-  using offset_type = signed int; // could've been `std::ptrdiff_t`, but this should be enough in practice
+  // `std::default_delete` is rebound to the destination type, other deleters are moved as they are
+  template<typename Deleter, typename DestinationValue>
+  struct unique_pointer_cast_deleter
+  {
+    using type = Deleter;
+  };
+
+  template<typename SourceValue, typename DestinationValue>
+  struct unique_pointer_cast_deleter<std::default_delete<SourceValue>, DestinationValue>
+  {
+    using type = std::default_delete<DestinationValue>;
+  };
+} // namespace detail::cached_dynamic_cast_detail
 
-  using global_cache_type =
-    std::unordered_map<std::type_index /* destination STATIC type */,
-                       std::unordered_map<std::type_index /* source DYNAMIC type */,
-                                          std::pair<bool /* is the cast possible? */,
-                                                    std::unordered_map<std::type_index /* source STATIC type */,
-                                                                       offset_type>>>>;
+// cast from an rvalue `std::unique_ptr` to a `std::unique_ptr`: the ownership is transferred on success only,
+// otherwise `source_unique_pointer` is left intact
+template<typename DestinationValue, typename SourceValue, typename Deleter>
+[[nodiscard]] inline std::unique_ptr<DestinationValue,
+                                     typename detail::cached_dynamic_cast_detail::unique_pointer_cast_deleter<Deleter, DestinationValue>::type>
+cached_dynamic_pointer_cast(std::unique_ptr<SourceValue, Deleter>&& source_unique_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  static_assert(!std::is_array_v<SourceValue> && !std::is_array_v<DestinationValue>);
 
-  extern global_cache_type global_cache;
-  extern std::shared_mutex global_cache_mutex;
+  using ResultDeleter = typename detail::cached_dynamic_cast_detail::unique_pointer_cast_deleter<Deleter, DestinationValue>::type;
+  // the object is going to be deleted through a pointer to `DestinationValue`
+  static_assert(!std::is_same_v<ResultDeleter, std::default_delete<DestinationValue>> || std::has_virtual_destructor_v<DestinationValue>);
 
-  [[nodiscard]] inline offset_type checked_cast_to_offset(const std::ptrdiff_t wide_offset)
+  DestinationValue* const result = cached_dynamic_cast<DestinationValue*>(source_unique_pointer.get()
+                                                                         CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  if (result == nullptr)
   {
-    if ((wide_offset > static_cast<std::ptrdiff_t>(std::numeric_limits<offset_type>::min()))
-     && (wide_offset < static_cast<std::ptrdiff_t>(std::numeric_limits<offset_type>::max())))
-      return static_cast<offset_type>(wide_offset);
+    if constexpr (std::is_default_constructible_v<ResultDeleter> && !std::is_pointer_v<ResultDeleter>)
+      return {};
     else
-      throw std::logic_error{"offset is too large"};
+      return { nullptr, source_unique_pointer.get_deleter() };
   }
-} // namespace detail::cached_dynamic_cast_detail
 
-inline void reset_cached_dynamic_cast_global_cache()
+  if constexpr (std::is_same_v<ResultDeleter, Deleter>)
+  {
+    std::unique_ptr<DestinationValue, Deleter> destination_unique_pointer{
+      result, std::forward<Deleter>(source_unique_pointer.get_deleter()) };
+    static_cast<void>(source_unique_pointer.release());
+    return destination_unique_pointer;
+  }
+  else
+  {
+    static_cast<void>(source_unique_pointer.release());
+    return std::unique_ptr<DestinationValue, ResultDeleter>{ result };
+  }
+}
+
+// cast from a `std::unique_ptr` to a plain pointer, the ownership stays with `source_unique_pointer`
+template<typename DestinationValue, typename SourceValue, typename Deleter>
+[[nodiscard]] inline DestinationValue*
+cached_dynamic_observer_cast(const std::unique_ptr<SourceValue, Deleter>& source_unique_pointer
+                             CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
 {
-  std::unique_lock writer_lock{ detail::cached_dynamic_cast_detail::global_cache_mutex };
-  detail::cached_dynamic_cast_detail::global_cache.clear();
+  return cached_dynamic_cast<DestinationValue*>(source_unique_pointer.get() CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
 }
 
-// primary template: cast from a pointer type to a pointer type
-template<typename DestinationPointer, typename SourcePointer>
-[[nodiscard]] inline std::enable_if_t<std::is_pointer_v<DestinationPointer>, DestinationPointer>
-cached_dynamic_cast(SourcePointer const source_pointer)
+// customization point for intrusive reference-counted smart pointers (like `boost::intrusive_ptr`), e.g.
+//   template<typename T>
+//   struct cached_dynamic_cast_intrusive_pointer_traits<my_intrusive_pointer<T>>
+//   {
+//     template<typename U> using rebind = my_intrusive_pointer<U>;
+//     static T* get(const my_intrusive_pointer<T>& pointer) noexcept;
+//     // a new pointer to `object`, which is the object owned by `source`: adds a reference
+//     template<typename U> static rebind<U> share(const my_intrusive_pointer<T>& source, U* object);
+//     // the same, taking over the reference held by `source`, which is left empty
+//     template<typename U> static rebind<U> transfer(my_intrusive_pointer<T>&& source, U* object) noexcept;
+//   };
+// then `cached_dynamic_pointer_cast` and `cached_dynamic_observer_cast` accept such pointers too
+template<typename Pointer>
+struct cached_dynamic_cast_intrusive_pointer_traits; // not defined: not an intrusive pointer
+
+namespace detail::cached_dynamic_cast_detail
 {
-  static_assert(std::is_pointer_v<SourcePointer>); // casting to a pointer type is allowed from a pointer type only
+  template<typename Pointer, typename = void>
+  struct is_intrusive_pointer : std::false_type
+  {
+  };
 
-  using SourceValue = std::remove_pointer_t<SourcePointer>;
-  using DestinationValue = std::remove_pointer_t<DestinationPointer>;
+  template<typename Pointer>
+  struct is_intrusive_pointer<Pointer, std::void_t<decltype(sizeof(cached_dynamic_cast_intrusive_pointer_traits<Pointer>))>>
+    : std::true_type
+  {
+  };
 
-  // adding cv-qualifiers is okay, but removing them is not
-  static_assert(static_cast<int>(std::is_const_v<DestinationValue>)
-             >= static_cast<int>(std::is_const_v<SourceValue>));
-  static_assert(static_cast<int>(std::is_volatile_v<DestinationValue>)
-             >= static_cast<int>(std::is_volatile_v<SourceValue>));
+  template<typename Pointer>
+  using intrusive_pointer_traits = cached_dynamic_cast_intrusive_pointer_traits<std::remove_cv_t<std::remove_reference_t<Pointer>>>;
 
-  using SourceValueNoCV = std::remove_cv_t<SourceValue>;
-  using DestinationValueNoCV = std::remove_cv_t<DestinationValue>;
+  template<typename DestinationValue, typename Pointer>
+  using rebound_intrusive_pointer = typename intrusive_pointer_traits<Pointer>::template rebind<DestinationValue>;
 
-  // casting is supported for polymorphic class types only (at least for now)
-  static_assert(std::is_polymorphic_v<SourceValueNoCV>);
-  static_assert(std::is_polymorphic_v<DestinationValueNoCV>);
+  template<typename Pointer, typename Result = void>
+  using enable_if_intrusive_pointer_t =
+    std::enable_if_t<is_intrusive_pointer<std::remove_cv_t<std::remove_reference_t<Pointer>>>::value, Result>;
+} // namespace detail::cached_dynamic_cast_detail
 
-  // don't waste time if the types are actually the same
-  // or if the source type is publicly derived from the destination type
-  if constexpr (std::is_base_of_v<DestinationValueNoCV, SourceValueNoCV>
-             && std::is_convertible_v<SourceValueNoCV*, DestinationValueNoCV*>)
-    return source_pointer;
+// cast from an intrusive smart pointer (see `cached_dynamic_cast_intrusive_pointer_traits`) to the same smart pointer
+// to `DestinationValue`: an lvalue source gets one more reference on success, an rvalue one hands its reference over
+// on success and is left intact otherwise, so no reference count is touched
+template<typename DestinationValue, typename Pointer>
+[[nodiscard]] inline detail::cached_dynamic_cast_detail::enable_if_intrusive_pointer_t<
+  Pointer, detail::cached_dynamic_cast_detail::rebound_intrusive_pointer<DestinationValue, Pointer>>
+cached_dynamic_pointer_cast(Pointer&& source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  using traits = detail::cached_dynamic_cast_detail::intrusive_pointer_traits<Pointer>;
 
-  // filter out the case where the client attempts to cast from a null pointer
-  if (source_pointer == nullptr)
-    return nullptr;
+  DestinationValue* const result = cached_dynamic_cast<DestinationValue*>(traits::get(source_pointer)
+                                                                         CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  if (result == nullptr)
+    return {};
+  if constexpr (std::is_lvalue_reference_v<Pointer>)
+    return traits::share(source_pointer, result);
+  else
+    return traits::transfer(std::move(source_pointer), result);
+}
 
-  const std::type_index destination_type{ typeid(DestinationValueNoCV) };
-  const std::type_index source_dynamic_type{ typeid(*source_pointer) };
+// cast from an intrusive smart pointer to a plain pointer, no reference count is touched
+template<typename DestinationValue, typename Pointer>
+[[nodiscard]] inline detail::cached_dynamic_cast_detail::enable_if_intrusive_pointer_t<Pointer, DestinationValue*>
+cached_dynamic_observer_cast(const Pointer& source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  using traits = detail::cached_dynamic_cast_detail::intrusive_pointer_traits<Pointer>;
+  return cached_dynamic_cast<DestinationValue*>(traits::get(source_pointer) CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+}
 
-  // shortcut for casting to a `final` class
-  if constexpr (std::is_final_v<DestinationValueNoCV>)
-    if (source_dynamic_type != destination_type)
-      return nullptr;
+namespace detail::cached_dynamic_cast_detail
+{
+  // stands in for the vtable pointer of a null source pointer, so that a block of keys is loaded without branches
+  inline const void* const null_pointer_dynamic_type_key = nullptr;
 
-  const std::type_index source_static_type{ typeid(SourceValueNoCV) };
+  // the batch casts below go through the caches once per run of consecutive objects with the same dynamic type key
+  // (`null_pointer_dynamic_type_key` for null pointers), a run is then handled by adding the same offset, and
+  // counted as the hits or negative hits its casts would have been one by one;
+  // blocks of `batch_block_size` pointers are written so that compilers may vectorize them
+  inline constexpr std::size_t batch_block_size = 8;
 
-  // main logic of the cached dynamic cast from a non-null source pointer
-  using namespace detail::cached_dynamic_cast_detail;
-  if (std::shared_lock reader_lock{ global_cache_mutex }; true)
+  template<typename DestinationPointer, typename SourcePointer, typename Sink>
+  inline void for_each_batch_cast(const SourcePointer* const source_pointers, const std::size_t count, Sink&& sink
+                                  CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
   {
-    global_cache_type::const_iterator iter_destination_type = global_cache.find(destination_type);
-    if (iter_destination_type != global_cache.end())
+    static_assert(std::is_pointer_v<SourcePointer>); // casting to a pointer type is allowed from a pointer type only
+
+    using SourceValueNoCV = std::remove_cv_t<std::remove_pointer_t<SourcePointer>>;
+    using DestinationValueNoCV = std::remove_cv_t<std::remove_pointer_t<DestinationPointer>>;
+    if constexpr (std::is_base_of_v<DestinationValueNoCV, SourceValueNoCV>
+               && std::is_convertible_v<SourceValueNoCV*, DestinationValueNoCV*>)
+    {
+      for (std::size_t index = 0; index < count; ++index)
+        sink(index, cached_dynamic_cast<DestinationPointer>(source_pointers[index] CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT));
+      return;
+    }
+
+    const void* current_key = &null_pointer_dynamic_type_key; // never equal to an actual key
+    offset_type current_offset = impossible_cast_offset;
+
+    const auto key_of = [](SourcePointer const source_pointer) noexcept -> const void*
+    {
+#if CACHED_DYNAMIC_CAST_USE_VPTR_KEYS
+      const void* const* const vptr_location = (source_pointer != nullptr)
+        ? static_cast<const void* const*>(const_cast<const void*>(static_cast<const volatile void*>(source_pointer)))
+        : &null_pointer_dynamic_type_key;
+      const void* key;
+      std::memcpy(&key, vptr_location, sizeof(key));
+      return key;
+#else
+      return (source_pointer != nullptr) ? dynamic_type_key(source_pointer) : null_pointer_dynamic_type_key;
+#endif
+    };
+
+    // `source_pointer` is any object of the current run, null pointers are not counted as casts
+    const auto count_run_lookups = [&](SourcePointer const source_pointer, const std::size_t run_length)
     {
-      auto& map_source_dynamic_types = iter_destination_type->second;
-      auto iter_source_dynamic_type = map_source_dynamic_types.find(source_dynamic_type);
-      if (iter_source_dynamic_type != map_source_dynamic_types.end())
+      if constexpr (statistics_level > 0)
       {
-        auto& [is_cast_possible, map_source_static_types] = iter_source_dynamic_type->second;
-        if (is_cast_possible)
-        {
-          auto iter_source_static_type = map_source_static_types.find(source_static_type);
-          if (iter_source_static_type != map_source_static_types.end())
-          {
-            const offset_type offset = iter_source_static_type->second;
-            return const_cast<DestinationPointer>(
-              reinterpret_cast<const volatile DestinationValueNoCV*>(
-                reinterpret_cast<const volatile unsigned char*>(source_pointer) + offset));
-          }
-        }
-        else
-        {
-          // the cast from the source DYNAMIC type to the destination type is impossible
-          return nullptr;
-        }
+        if (source_pointer != nullptr)
+          count_lookup((current_offset != impossible_cast_offset) ? lookup_outcome::hit : lookup_outcome::negative_hit,
+                       typeid(DestinationValueNoCV), source_pointer, CACHED_DYNAMIC_CAST_DETAIL_CALLER, run_length);
+      }
+    };
+
+    const auto cast_one = [&](const std::size_t index)
+    {
+      SourcePointer const source_pointer = source_pointers[index];
+      const void* const key = key_of(source_pointer);
+      if (key != current_key)
+      {
+        current_key = key;
+        current_offset = (source_pointer != nullptr)
+          ? offset_between(cached_dynamic_cast<DestinationPointer>(source_pointer CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT),
+                           source_pointer)
+          : impossible_cast_offset;
+      }
+      else
+        count_run_lookups(source_pointer, 1);
+      sink(index, (current_offset != impossible_cast_offset)
+                  ? apply_offset<DestinationPointer>(source_pointer, current_offset)
+                  : DestinationPointer{ nullptr });
+    };
+
+    std::size_t index = 0;
+    for (; index + batch_block_size <= count; index += batch_block_size)
+    {
+      // branch-free check whether the whole block continues the current run
+      bool is_same_run = true;
+      for (std::size_t i = 0; i < batch_block_size; ++i)
+        is_same_run &= (key_of(source_pointers[index + i]) == current_key);
+
+      if (is_same_run)
+        count_run_lookups(source_pointers[index], batch_block_size);
+      if (is_same_run && current_offset == impossible_cast_offset)
+      {
+        for (std::size_t i = 0; i < batch_block_size; ++i)
+          sink(index + i, DestinationPointer{ nullptr });
+      }
+      else if (is_same_run)
+      {
+        for (std::size_t i = 0; i < batch_block_size; ++i)
+          sink(index + i, apply_offset<DestinationPointer>(source_pointers[index + i], current_offset));
+      }
+      else
+      {
+        // interleaved dynamic types: tracking runs would not pay off, only the last element starts a new one
+        for (std::size_t i = 0; i + 1 < batch_block_size; ++i)
+          sink(index + i, cached_dynamic_cast<DestinationPointer>(source_pointers[index + i] CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT));
+        cast_one(index + batch_block_size - 1);
       }
     }
+    for (; index < count; ++index)
+      cast_one(index);
   }
+} // namespace detail::cached_dynamic_cast_detail
+
+// casts `count` pointers into `destination_pointers`, producing the same results as `cached_dynamic_cast` one by one
+template<typename DestinationPointer, typename SourcePointer>
+inline std::enable_if_t<std::is_pointer_v<DestinationPointer>>
+cached_dynamic_cast_n(const SourcePointer* const source_pointers, const std::size_t count,
+                      DestinationPointer* const destination_pointers CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  detail::cached_dynamic_cast_detail::for_each_batch_cast<DestinationPointer>(source_pointers, count,
+    [destination_pointers](const std::size_t index, DestinationPointer const destination_pointer) noexcept
+    {
+      destination_pointers[index] = destination_pointer;
+    } CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+}
+
+// compacting variant: writes only the successfully cast pointers, returns the number of them
+template<typename DestinationPointer, typename SourcePointer>
+[[nodiscard]] inline std::enable_if_t<std::is_pointer_v<DestinationPointer>, std::size_t>
+cached_dynamic_cast_filter(const SourcePointer* const source_pointers, const std::size_t count,
+                           DestinationPointer* const destination_pointers CACHED_DYNAMIC_CAST_DETAIL_CALLER_PARAMETER)
+{
+  std::size_t result_count = 0;
+  detail::cached_dynamic_cast_detail::for_each_batch_cast<DestinationPointer>(source_pointers, count,
+    [destination_pointers, &result_count](std::size_t, DestinationPointer const destination_pointer) noexcept
+    {
+      // always written, only kept if not null
+      destination_pointers[result_count] = destination_pointer;
+      result_count += (destination_pointer != nullptr);
+    } CACHED_DYNAMIC_CAST_DETAIL_CALLER_ARGUMENT);
+  return result_count;
+}
+
+namespace detail::cached_dynamic_cast_detail
+{
+  // the parameter and the result of a `cached_type_switch` handler: a function pointer or a function object
+  // with a single non-template `operator()`, taking a reference to a polymorphic class
+  template<typename Handler>
+  struct type_switch_handler_traits : type_switch_handler_traits<decltype(&Handler::operator())>
+  {
+  };
+
+  template<typename Result, typename Parameter>
+  struct type_switch_handler_traits<Result (*)(Parameter)>
+  {
+    static_assert(std::is_lvalue_reference_v<Parameter>); // handlers take the object by reference
+    using parameter = std::remove_reference_t<Parameter>;
+    using result = Result;
+  };
+
+  template<typename Result, typename Parameter>
+  struct type_switch_handler_traits<Result (*)(Parameter) noexcept> : type_switch_handler_traits<Result (*)(Parameter)>
+  {
+  };
+
+  template<typename Class, typename Result, typename Parameter>
+  struct type_switch_handler_traits<Result (Class::*)(Parameter)> : type_switch_handler_traits<Result (*)(Parameter)>
+  {
+  };
+
+  template<typename Class, typename Result, typename Parameter>
+  struct type_switch_handler_traits<Result (Class::*)(Parameter) const> : type_switch_handler_traits<Result (*)(Parameter)>
+  {
+  };
+
+  template<typename Class, typename Result, typename Parameter>
+  struct type_switch_handler_traits<Result (Class::*)(Parameter) noexcept> : type_switch_handler_traits<Result (*)(Parameter)>
+  {
+  };
+
+  template<typename Class, typename Result, typename Parameter>
+  struct type_switch_handler_traits<Result (Class::*)(Parameter) const noexcept> : type_switch_handler_traits<Result (*)(Parameter)>
+  {
+  };
+
+  template<typename Handler>
+  using type_switch_parameter_t = typename type_switch_handler_traits<std::decay_t<Handler>>::parameter;
+
+  template<typename Handler>
+  using type_switch_parameter_no_cv_t = std::remove_cv_t<type_switch_parameter_t<Handler>>;
+
+  // `bool` (whether a handler was called) for handlers returning `void`, otherwise the result of the handler, if any
+  template<typename HandlerResult>
+  using type_switch_result_t = std::conditional_t<std::is_void_v<HandlerResult>, bool, std::optional<HandlerResult>>;
+
+  // a class rather than an alias, so that it is not instantiated for the overloads discarded by `enable_if`
+  template<typename FirstHandler, typename... Handlers>
+  struct type_switch_result_of_handlers
+  {
+    using type = type_switch_result_t<typename type_switch_handler_traits<std::decay_t<FirstHandler>>::result>;
+  };
 
-  // if reached this line, there is no entry about the attempted cast in the global cache (yet):
-  // perform a standard C++ dynamic_cast, then add an entry about its result to the cache
-  DestinationPointer const destination_pointer = dynamic_cast<DestinationPointer>(source_pointer);
+  template<typename... Handlers>
+  using type_switch_result_of_handlers_t = typename type_switch_result_of_handlers<Handlers...>::type;
 
-  const offset_type offset{
-    (destination_pointer != nullptr)
-    ? checked_cast_to_offset(
-        reinterpret_cast<const volatile unsigned char*>(destination_pointer) -
-        reinterpret_cast<const volatile unsigned char*>(source_pointer))
-    : 0 /* this is invalid, but it will not be used anyway */
+  // stands for the destination type in the cache keys of a type switch, whose entries pack the index
+  // of the handler to call together with the offset, see `pack_type_switch_entry()`
+  template<typename... DestinationValuesNoCV>
+  struct type_switch_tag
+  {
   };
 
-  if (std::unique_lock writer_lock{ global_cache_mutex }; true)
+  template<std::size_t HandlerCount>
+  [[nodiscard]] inline offset_type pack_type_switch_entry(const std::size_t handler_index,
+                                                          const volatile void* const destination_pointer,
+                                                          const volatile void* const source_pointer)
+  {
+    const std::ptrdiff_t offset = static_cast<const volatile unsigned char*>(destination_pointer) -
+                                  static_cast<const volatile unsigned char*>(source_pointer);
+    return checked_cast_to_offset(offset * static_cast<std::ptrdiff_t>(HandlerCount) + static_cast<std::ptrdiff_t>(handler_index));
+  }
+
+  template<typename Result, std::size_t Index, typename SourcePointer, typename HandlerTuple>
+  inline Result invoke_type_switch_handler(SourcePointer const source_pointer, const offset_type offset, HandlerTuple& handlers)
   {
-    auto& [is_cast_possible, map_source_static_types] = global_cache[destination_type][source_dynamic_type];
-    if (destination_pointer != nullptr)
+    using Handler = std::tuple_element_t<Index, HandlerTuple>;
+    type_switch_parameter_t<Handler>& object = *apply_offset<type_switch_parameter_t<Handler>*>(source_pointer, offset);
+    if constexpr (std::is_same_v<Result, bool>
+               && std::is_void_v<typename type_switch_handler_traits<std::decay_t<Handler>>::result>)
     {
-      is_cast_possible = true;
-      map_source_static_types[source_static_type] = offset;
+      std::invoke(std::get<Index>(handlers), object);
+      return true;
     }
     else
     {
-      is_cast_possible = false;
+      return Result{ std::invoke(std::get<Index>(handlers), object) };
     }
-    return destination_pointer;
   }
-}
 
-// cast from a reference type to a reference type
-template<typename DestinationReference, typename SourceValue>
-[[nodiscard]] inline std::enable_if_t<std::is_reference_v<DestinationReference>, DestinationReference>
-cached_dynamic_cast(SourceValue& source_reference)
-{
-  static_assert(!std::is_pointer_v<SourceValue>); // casting from a reference to a pointer... what?
-  static_assert(!std::is_rvalue_reference_v<DestinationReference>); // casting to an rvalue reference is not allowed
+  // one cache lookup for the whole switch: the entry of (tag, source DYNAMIC type, source STATIC type) tells
+  // which handler applies (the first one whose parameter the object can be cast to) and at which offset,
+  // then the handler is called through a table indexed by the handler index
+  template<typename SourcePointer, typename... Handlers, std::size_t... Indices>
+  inline type_switch_result_of_handlers_t<Handlers...> type_switch(cast_cache& cache, SourcePointer const source_pointer,
+                                                                   std::tuple<Handlers...> handlers,
+                                                                   std::index_sequence<Indices...>)
+  {
+    using Result = type_switch_result_of_handlers_t<Handlers...>;
+    using SourceValue = std::remove_pointer_t<SourcePointer>;
+    using SourceValueNoCV = std::remove_cv_t<SourceValue>;
+    using HandlerTuple = std::tuple<Handlers...>;
+    constexpr std::size_t handler_count = sizeof...(Handlers);
+    using FirstParameterNoCV = type_switch_parameter_no_cv_t<std::tuple_element_t<0, HandlerTuple>>;
 
-  using DestinationValue = std::remove_reference_t<DestinationReference>;
-  static_assert(!std::is_pointer_v<DestinationValue>); // casting to a reference to a pointer... what??? :)
+    static_assert(std::is_polymorphic_v<SourceValueNoCV>);
+    static_assert((std::is_polymorphic_v<type_switch_parameter_no_cv_t<Handlers>> && ...));
+    static_assert((std::is_same_v<typename type_switch_handler_traits<std::decay_t<Handlers>>::result,
+                                  typename type_switch_handler_traits<std::decay_t<std::tuple_element_t<0, HandlerTuple>>>::result> && ...),
+                  "all the handlers must return the same type");
 
-  DestinationValue* destination_pointer = cached_dynamic_cast<DestinationValue*>(std::addressof(source_reference));
-  if (destination_pointer != nullptr)
-    return *destination_pointer;
-  else
-    throw std::bad_cast{};
+    // adding cv-qualifiers is okay, but removing them is not
+    static_assert(((static_cast<int>(std::is_const_v<type_switch_parameter_t<Handlers>>) >= static_cast<int>(std::is_const_v<SourceValue>)) && ...));
+    static_assert(((static_cast<int>(std::is_volatile_v<type_switch_parameter_t<Handlers>>) >= static_cast<int>(std::is_volatile_v<SourceValue>)) && ...));
+
+    if (source_pointer == nullptr)
+      return Result{};
+
+    // an upcast in the first handler always applies
+    if constexpr (std::is_base_of_v<FirstParameterNoCV, SourceValueNoCV> && std::is_convertible_v<SourceValueNoCV*, FirstParameterNoCV*>)
+      return invoke_type_switch_handler<Result, 0>(source_pointer, offset_between(static_cast<const volatile FirstParameterNoCV*>(source_pointer),
+                                                                                  source_pointer), handlers);
+
+    using Tag = type_switch_tag<type_switch_parameter_no_cv_t<Handlers>...>;
+    const std::type_info& destination_type = typeid(Tag);
+
+    // shortcut for handlers of `final` classes only
+    if constexpr ((std::is_final_v<type_switch_parameter_no_cv_t<Handlers>> && ...))
+    {
+      const std::type_info& dynamic_type = typeid(*source_pointer);
+      if (((dynamic_type != typeid(type_switch_parameter_no_cv_t<Handlers>)) && ...))
+      {
+        count_lookup(lookup_outcome::negative_hit, destination_type, source_pointer, call_location{});
+        return Result{};
+      }
+    }
+
+    using invoke_function = Result (*)(SourcePointer, offset_type, HandlerTuple&);
+    static constexpr invoke_function invoke_functions[] = { &invoke_type_switch_handler<Result, Indices, SourcePointer, HandlerTuple>... };
+
+    const cache_key key{ &destination_type, dynamic_type_key(source_pointer), &typeid(SourceValueNoCV) };
+    const epoch_type epoch = cache.current_epoch();
+
+    offset_type packed_entry = find_offset(cache, key, epoch);
+    if (packed_entry == impossible_cast_offset)
+    {
+      count_lookup(lookup_outcome::negative_hit, destination_type, source_pointer, call_location{});
+      return Result{};
+    }
+    if (packed_entry != missing_entry_offset)
+    {
+      count_lookup(lookup_outcome::hit, destination_type, source_pointer, call_location{});
+    }
+    else
+    {
+      if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_entry))
+        fire_slow_path_entry_probe(destination_type, typeid(*source_pointer));
+      const statistics_stopwatch slow_path_stopwatch{ CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit) };
+      packed_entry = impossible_cast_offset;
+      const auto try_handler = [&](const std::size_t index, const volatile void* const destination_pointer)
+      {
+        if (destination_pointer == nullptr)
+          return false;
+        packed_entry = pack_type_switch_entry<handler_count>(index, destination_pointer, source_pointer);
+        return true;
+      };
+      static_cast<void>((try_handler(Indices, dynamic_cast<const volatile type_switch_parameter_no_cv_t<Handlers>*>(source_pointer)) || ...));
+      const std::uint64_t dynamic_cast_nanoseconds =
+        CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit) ? slow_path_stopwatch.elapsed_nanoseconds() : 0;
+      store_offset(cache, key, epoch, packed_entry);
+      slow_path_stopwatch.add_elapsed_time_to(&thread_statistics_counters::slow_path_nanoseconds);
+      count_lookup(lookup_outcome::miss, destination_type, source_pointer, call_location{});
+      if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(slow_path_exit))
+        fire_slow_path_exit_probe(destination_type, typeid(*source_pointer), dynamic_cast_nanoseconds,
+                                  packed_entry != impossible_cast_offset);
+      if (packed_entry == impossible_cast_offset)
+        return Result{};
+    }
+
+    constexpr auto signed_handler_count = static_cast<offset_type>(handler_count);
+    const offset_type handler_index = (packed_entry % signed_handler_count + signed_handler_count) % signed_handler_count;
+    return invoke_functions[handler_index](source_pointer, (packed_entry - handler_index) / signed_handler_count, handlers);
+  }
+} // namespace detail::cached_dynamic_cast_detail
+
+// calls the first of the `handlers` whose parameter (a reference to a polymorphic class) `source_pointer` can be
+// cast to, like a chain of `if (auto* a = cached_dynamic_cast<A*>(p)) ... else if (auto* b = ...)`, but with
+// a single cache lookup: which handler applies and at which offset is cached per source DYNAMIC type;
+// returns `bool` (whether a handler was called) if the handlers return `void`, otherwise an `std::optional`
+// of their (common) result type, empty if no handler was called (e.g. for a null pointer)
+template<typename SourcePointer, typename... Handlers>
+inline typename std::enable_if_t<std::is_pointer_v<SourcePointer>,
+                                 detail::cached_dynamic_cast_detail::type_switch_result_of_handlers<Handlers...>>::type
+cached_type_switch(SourcePointer const source_pointer, Handlers&&... handlers)
+{
+  return detail::cached_dynamic_cast_detail::type_switch(default_cast_cache(), source_pointer,
+                                                         std::forward_as_tuple(std::forward<Handlers>(handlers)...),
+                                                         std::index_sequence_for<Handlers...>{});
 }
 
-// cast from an lvalue `std::shared_ptr` to a `std::shared_ptr`
-template<typename DestinationValue, typename SourceValue>
-[[nodiscard]] inline std::shared_ptr<DestinationValue>
-cached_dynamic_pointer_cast(const std::shared_ptr<SourceValue>& source_shared_pointer)
+// the same, through the given cache domain
+template<typename SourcePointer, typename... Handlers>
+inline typename std::enable_if_t<std::is_pointer_v<SourcePointer>,
+                                 detail::cached_dynamic_cast_detail::type_switch_result_of_handlers<Handlers...>>::type
+cached_type_switch(cast_cache& cache, SourcePointer const source_pointer, Handlers&&... handlers)
 {
-  auto* result = cached_dynamic_cast<typename std::shared_ptr<DestinationValue>::element_type*>(source_shared_pointer.get());
-  if (result)
-    return std::shared_ptr<DestinationValue>{source_shared_pointer, result};
-  else
-    return {};
+  return detail::cached_dynamic_cast_detail::type_switch(cache, source_pointer,
+                                                         std::forward_as_tuple(std::forward<Handlers>(handlers)...),
+                                                         std::index_sequence_for<Handlers...>{});
 }
 
-// cast from an rvalue `std::shared_ptr` to a `std::shared_ptr`
-template<typename DestinationValue, typename SourceValue>
-[[nodiscard]] inline std::shared_ptr<DestinationValue>
-cached_dynamic_pointer_cast(std::shared_ptr<SourceValue>&& source_shared_pointer)
+namespace detail::cached_dynamic_cast_detail
 {
-  auto* result = cached_dynamic_cast<typename std::shared_ptr<DestinationValue>::element_type*>(source_shared_pointer.get());
-  if (result)
-    return std::shared_ptr<DestinationValue>{std::move(source_shared_pointer), result};
-  else
-    return {};
+  using prewarm_function = void (*)(std::vector<cache_entry>& entries);
+
+  bool register_prewarm(prewarm_function prewarm); // in cached_dynamic_cast.cpp
+
+  // appends the entries that casting `object` to `DestinationValue` through each of the `SourceValues` would store
+  template<typename DestinationValue, typename... SourceValues, typename DynamicValue>
+  inline void collect_prewarm_entries(const DynamicValue& object, std::vector<cache_entry>& entries)
+  {
+    static_assert(sizeof...(SourceValues) > 0); // at least one source STATIC type is needed
+    static_assert(std::is_polymorphic_v<DestinationValue>);
+    static_assert((std::is_polymorphic_v<SourceValues> && ...));
+    static_assert((std::is_convertible_v<const DynamicValue*, const SourceValues*> && ...));
+
+    const auto collect = [&](const auto* const source_pointer)
+    {
+      using SourceValueNoCV = std::remove_cv_t<std::remove_pointer_t<decltype(source_pointer)>>;
+      const cache_key key{ &typeid(std::remove_cv_t<DestinationValue>), dynamic_type_key(source_pointer), &typeid(SourceValueNoCV) };
+      entries.push_back(cache_entry{ key, offset_between(dynamic_cast<const volatile DestinationValue*>(source_pointer),
+                                                         source_pointer) });
+    };
+    (collect(static_cast<const SourceValues*>(&object)), ...);
+  }
+} // namespace detail::cached_dynamic_cast_detail
+
+// stores the results of casts from `object`, seen as each of the `Static` types, to `Destination` in the global
+// cache at once; they hold for every object of its dynamic type (which is the one warmed up, not necessarily
+// `Dynamic`), no object is created for them
+template<typename Destination, typename... Static, typename Dynamic>
+inline void cached_dynamic_cast_prewarm(const Dynamic& object)
+{
+  std::vector<detail::cached_dynamic_cast_detail::cache_entry> entries;
+  detail::cached_dynamic_cast_detail::collect_prewarm_entries<Destination, Static...>(object, entries);
+  detail::cached_dynamic_cast_detail::store_many_in_global_cache(entries.data(), entries.size());
 }
+
+#define CACHED_DYNAMIC_CAST_DETAIL_CONCATENATE_IMPLEMENTATION(a, b) a##b
+#define CACHED_DYNAMIC_CAST_DETAIL_CONCATENATE(a, b) CACHED_DYNAMIC_CAST_DETAIL_CONCATENATE_IMPLEMENTATION(a, b)
+
+// registers a warm-up (see `cached_dynamic_cast_prewarm<Destination, Static...>(object)`) to be run
+// by `prewarm_registered_cached_dynamic_casts()`; for namespace scope; `object` names an existing object, e.g. a
+// global or a call of a function returning a prototype, and is evaluated each time the warm-ups run, never during
+// static initialization; a hierarchy whose objects are not at hand then can be registered instead
+// (see `CACHED_DYNAMIC_CAST_REGISTER_CLASS`), its casts need no warm-up
+#define CACHED_DYNAMIC_CAST_PREWARM(Destination, object, ...) \
+  [[maybe_unused]] static const bool CACHED_DYNAMIC_CAST_DETAIL_CONCATENATE(cached_dynamic_cast_prewarm_registered_, __LINE__) = \
+    ::detail::cached_dynamic_cast_detail::register_prewarm( \
+      [](std::vector<::detail::cached_dynamic_cast_detail::cache_entry>& entries) \
+      { ::detail::cached_dynamic_cast_detail::collect_prewarm_entries<Destination, __VA_ARGS__>((object), entries); })
+
+#if CACHED_DYNAMIC_CAST_HEADER_ONLY
+#include "cached_dynamic_cast.cpp"
+#include "cached_dynamic_cast_snapshot_file.cpp"
+#endif
@@ -0,0 +1,835 @@
+#pragma once
+
+#include "cached_dynamic_cast.hpp"
+#include "cached_dynamic_cast_flat_table.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#if defined(__linux__)
+#include <fstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace detail::cached_dynamic_cast_detail
+{
+  // the slot arrays of the tables come from pools, so that the arrays freed by growing a table, by `compact()`
+  // or by retiring a snapshot are reused instead of going back to the upstream resource (a pool gives its memory
+  // back only when it is destroyed); bigger arrays are rare and go to the upstream resource directly
+  inline const std::pmr::pool_options slot_pool_options{ 0, std::size_t{ 64 } * 1024 };
+
+  // `CACHED_DYNAMIC_CAST_BACKEND_LOCKED_TABLE`: flat tables guarded by reader-writer locks, split into
+  // `global_cache_shard_count` shards by the hash of the full key, so that the writer lock taken by a miss
+  // only stalls the readers of one shard; the capacity is divided between the shards
+  class locked_cache
+  {
+  public:
+    explicit locked_cache(std::pmr::memory_resource* const upstream_memory)
+      : shards{ make_shards(upstream_memory, std::make_index_sequence<global_cache_shard_count>{}) }
+    {
+      set_shard_capacities(global_cache_capacity);
+    }
+
+    [[nodiscard]] offset_type find(const cache_key& key) const
+    {
+      const shard& key_shard = shard_of(key);
+      std::shared_lock reader_lock{ key_shard.mutex };
+      return key_shard.table.find(key);
+    }
+
+    void store(const cache_key& key, const offset_type offset)
+    {
+      shard& key_shard = shard_of(key);
+      const statistics_stopwatch writer_lock_stopwatch{ CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(writer_lock) };
+      std::unique_lock writer_lock{ key_shard.mutex };
+      [[maybe_unused]] const std::uint64_t wait_nanoseconds =
+        writer_lock_stopwatch.add_elapsed_time_to(&thread_statistics_counters::writer_lock_wait_nanoseconds);
+      if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(writer_lock))
+        CACHED_DYNAMIC_CAST_DETAIL_PROBE(writer_lock, shard_index(key), wait_nanoseconds);
+      key_shard.table.insert_or_assign(key, offset);
+    }
+
+    void store_many(const cache_entry* const entries, const std::size_t count)
+    {
+      for (std::size_t index = 0; index < global_cache_shard_count; ++index)
+      {
+        std::unique_lock<std::shared_mutex> writer_lock;
+        for (const cache_entry* entry = entries; entry != entries + count; ++entry)
+        {
+          if (shard_index(entry->key) != index)
+            continue;
+          if (!writer_lock.owns_lock())
+            writer_lock = std::unique_lock{ shards[index].mutex };
+          shards[index].table.insert_or_assign(entry->key, entry->offset);
+        }
+      }
+    }
+
+    // every shard is cleared on its own, concurrent lookups may see some of them cleared and some not yet
+    void clear()
+    {
+      for (shard& each_shard : shards)
+      {
+        std::unique_lock writer_lock{ each_shard.mutex };
+        each_shard.table.clear();
+      }
+    }
+
+    void copy_entries(std::vector<cache_entry>& entries) const
+    {
+      for (const shard& each_shard : shards)
+      {
+        std::shared_lock reader_lock{ each_shard.mutex };
+        each_shard.table.for_each([&entries](const cache_key& key, const offset_type offset)
+                                  { entries.push_back(cache_entry{ key, offset }); });
+      }
+    }
+
+    [[nodiscard]] cached_dynamic_cast_global_cache_usage usage() const
+    {
+      cached_dynamic_cast_global_cache_usage result{ 0, 0, capacity.load(std::memory_order_relaxed) };
+      for (const shard& each_shard : shards)
+      {
+        std::shared_lock reader_lock{ each_shard.mutex };
+        result.entry_count += each_shard.table.size();
+        result.bytes_used += each_shard.table.bytes_used();
+      }
+      return result;
+    }
+
+    void set_capacity(const std::size_t new_capacity)
+    {
+      capacity.store(new_capacity, std::memory_order_relaxed);
+      set_shard_capacities(new_capacity);
+    }
+
+    void compact()
+    {
+      for (shard& each_shard : shards)
+      {
+        std::unique_lock writer_lock{ each_shard.mutex };
+        each_shard.table.compact();
+      }
+    }
+
+    // scans every shard `erase_slots_per_lock` slots at a time, so that the writer lock is never held for long;
+    // a shard whose slots were moved around in between (by an eviction or by growing) is scanned again from its
+    // start, and after a few such restarts in one go, so that constant evictions cannot keep the scan from finishing
+    template<typename Predicate>
+    std::size_t erase_if(const Predicate& predicate)
+    {
+      std::size_t erased_count = 0;
+      for (shard& each_shard : shards)
+      {
+        std::size_t first_slot = 0;
+        std::uint64_t layout_version = 0;
+        unsigned restart_count = 0;
+        for (;;)
+        {
+          std::unique_lock writer_lock{ each_shard.mutex };
+          if (first_slot != 0 && each_shard.table.layout_version() != layout_version)
+          {
+            first_slot = 0;
+            ++restart_count;
+          }
+          const std::size_t count = (restart_count < max_erase_restarts) ? erase_slots_per_lock
+                                                                        : std::numeric_limits<std::size_t>::max();
+          erased_count += each_shard.table.erase_if(predicate, first_slot, count);
+          if (count >= each_shard.table.slot_count() - first_slot)
+            break;
+          first_slot += count;
+          layout_version = each_shard.table.layout_version();
+        }
+      }
+      return erased_count;
+    }
+
+  private:
+    static constexpr std::size_t erase_slots_per_lock = 256;
+    static constexpr unsigned max_erase_restarts = 4;
+
+    struct alignas(64) shard
+    {
+      explicit shard(std::pmr::memory_resource* const upstream_memory)
+        : memory{ slot_pool_options, upstream_memory }
+        , table{ &memory }
+      {
+      }
+
+      mutable std::shared_mutex mutex;
+      std::pmr::unsynchronized_pool_resource memory; // only used under the writer lock
+      flat_table table;
+    };
+
+    std::array<shard, global_cache_shard_count> shards;
+    std::atomic<std::size_t> capacity{ global_cache_capacity }; // as requested, the shards get rounded-up parts
+
+    template<std::size_t... Indices>
+    [[nodiscard]] static std::array<shard, global_cache_shard_count> make_shards(std::pmr::memory_resource* const upstream_memory,
+                                                                             std::index_sequence<Indices...>)
+    {
+      return { { shard{ (static_cast<void>(Indices), upstream_memory) }... } };
+    }
+
+    [[nodiscard]] static std::size_t shard_index(const cache_key& key) noexcept
+    {
+      // the low bits of the hash select slots inside the tables
+      return (hash_key(key) >> 24) % global_cache_shard_count;
+    }
+
+    [[nodiscard]] const shard& shard_of(const cache_key& key) const noexcept
+    {
+      return shards[shard_index(key)];
+    }
+
+    [[nodiscard]] shard& shard_of(const cache_key& key) noexcept
+    {
+      return shards[shard_index(key)];
+    }
+
+    void set_shard_capacities(const std::size_t total_capacity) noexcept
+    {
+      const std::size_t shard_capacity = (total_capacity + global_cache_shard_count - 1) / global_cache_shard_count;
+      for (shard& each_shard : shards)
+      {
+        std::unique_lock writer_lock{ each_shard.mutex };
+        each_shard.table.set_max_size(shard_capacity);
+      }
+    }
+  };
+
+  // epoch-based reclamation for `snapshot_cache`: a reader announces the reclamation epoch it
+  // started in, a retired object is deleted once every reader has announced a later epoch (or none at all);
+  // a reader only ever writes to its own cache line
+  class snapshot_reclamation
+  {
+  public:
+    // shared by all snapshot caches, so that every thread needs a single record
+    [[nodiscard]] static snapshot_reclamation& instance()
+    {
+      static snapshot_reclamation reclamation;
+      return reclamation;
+    }
+
+    struct alignas(64) reader_record
+    {
+      std::atomic<std::uint64_t> active_epoch{ 0 }; // 0: not reading at the moment
+      std::atomic<bool> is_owned{ false };
+      std::size_t guard_depth{ 0 }; // only used by the owning thread
+      reader_record* next{ nullptr };
+    };
+
+    // pins the current epoch for the lifetime of the guard; a nested guard keeps the epoch of the outermost one,
+    // which protects everything retired since, and only the outermost one withdraws it
+    class read_guard
+    {
+    public:
+      explicit read_guard(snapshot_reclamation& reclamation)
+        : record{ reclamation.thread_record() }
+      {
+        // the acquire pairs with the `fetch_add` of `retire`: whatever was retired before the epoch that is
+        // announced here has been unpublished before, so the loads under the guard cannot find it any more
+        if (record.guard_depth++ == 0)
+          record.active_epoch.store(reclamation.epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+      }
+
+      ~read_guard()
+      {
+        if (--record.guard_depth == 0)
+          record.active_epoch.store(0, std::memory_order_release);
+      }
+
+      read_guard(const read_guard&) = delete;
+      read_guard& operator=(const read_guard&) = delete;
+
+    private:
+      reader_record& record;
+    };
+
+    ~snapshot_reclamation()
+    {
+      for (reader_record* record = records.load(std::memory_order_acquire); record != nullptr; )
+        delete std::exchange(record, record->next);
+    }
+
+    // `retired` is deleted right away or by a later call, `memory` (that of its slots, if any) is released after it
+    void retire(std::shared_ptr<const void> retired, std::shared_ptr<std::pmr::memory_resource> memory = nullptr)
+    {
+      std::lock_guard retire_lock{ retire_mutex };
+      retired_objects.push_back(retired_object{ epoch.fetch_add(1, std::memory_order_seq_cst), std::move(memory),
+                                                std::move(retired) });
+
+      std::uint64_t oldest_active_epoch = std::numeric_limits<std::uint64_t>::max();
+      for (reader_record* record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+      {
+        const std::uint64_t active_epoch = record->active_epoch.load(std::memory_order_seq_cst);
+        if (active_epoch != 0 && active_epoch < oldest_active_epoch)
+          oldest_active_epoch = active_epoch;
+      }
+
+      // an object retired in epoch `e` may still be used by readers that have announced `e` or an earlier epoch
+      retired_objects.erase(std::remove_if(retired_objects.begin(), retired_objects.end(),
+                                           [oldest_active_epoch](const retired_object& retired)
+                                           { return retired.epoch < oldest_active_epoch; }),
+                            retired_objects.end());
+    }
+
+  private:
+    std::atomic<std::uint64_t> epoch{ 1 };
+    std::atomic<reader_record*> records{ nullptr }; // never shrinks, records of finished threads get reused
+    std::mutex retire_mutex;
+
+    struct retired_object
+    {
+      std::uint64_t epoch;
+      std::shared_ptr<std::pmr::memory_resource> memory; // destroyed after `object`, may outlive its cache
+      std::shared_ptr<const void> object; // deleted through the deleter it was retired with
+    };
+
+    std::vector<retired_object> retired_objects;
+
+    // gives the record back when its thread finishes
+    struct thread_record_owner
+    {
+      reader_record* record = nullptr;
+
+      ~thread_record_owner()
+      {
+        if (record != nullptr)
+          record->is_owned.store(false, std::memory_order_release);
+      }
+    };
+
+    [[nodiscard]] reader_record& thread_record()
+    {
+      thread_local thread_record_owner owner;
+      if (owner.record == nullptr)
+        owner.record = acquire_record();
+      return *owner.record;
+    }
+
+    [[nodiscard]] reader_record* acquire_record()
+    {
+      for (reader_record* record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+      {
+        bool is_owned = false;
+        if (!record->is_owned.load(std::memory_order_relaxed)
+         && record->is_owned.compare_exchange_strong(is_owned, true, std::memory_order_acquire))
+          return record;
+      }
+
+      auto* record = new reader_record{};
+      record->is_owned.store(true, std::memory_order_relaxed);
+      reader_record* head = records.load(std::memory_order_relaxed);
+      do
+        record->next = head;
+      while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+      return record;
+    }
+  };
+
+  // `CACHED_DYNAMIC_CAST_BACKEND_SNAPSHOT`: an immutable table published through an atomic pointer (RCU-style);
+  // readers never take a lock, every miss copies the table, so this suits workloads where new pairs are rare;
+  // readers do not write to the snapshot either, not even the CLOCK reference bits, so a bounded snapshot evicts
+  // in the order of the clock hand without giving recently found entries a second chance
+  class snapshot_cache
+  {
+  public:
+    // the tables are allocated and freed by any thread, so the pool is a synchronized one
+    explicit snapshot_cache(std::pmr::memory_resource* const upstream_memory)
+      : memory{ std::make_shared<std::pmr::synchronized_pool_resource>(slot_pool_options, upstream_memory) }
+    {
+    }
+
+    ~snapshot_cache()
+    {
+      delete current.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] offset_type find(const cache_key& key)
+    {
+      snapshot_reclamation::read_guard guard{ snapshot_reclamation::instance() };
+      const flat_table* const table = current.load(std::memory_order_seq_cst);
+      return (table != nullptr) ? table->find(key) : missing_entry_offset;
+    }
+
+    void store(const cache_key& key, const offset_type offset)
+    {
+      const cache_entry entry{ key, offset };
+      store_many(&entry, 1);
+    }
+
+    // entries stored by concurrent misses are batched into one new snapshot
+    void store_many(const cache_entry* const new_entries, const std::size_t count)
+    {
+      if (std::lock_guard pending_lock{ pending_mutex }; true)
+        for (const cache_entry* entry = new_entries; entry != new_entries + count; ++entry)
+          pending_entries.push_back(flat_table_slot{ entry->key, entry->offset });
+
+      const statistics_stopwatch writer_lock_stopwatch{ CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(writer_lock) };
+      std::lock_guard publish_lock{ publish_mutex };
+      [[maybe_unused]] const std::uint64_t wait_nanoseconds =
+        writer_lock_stopwatch.add_elapsed_time_to(&thread_statistics_counters::writer_lock_wait_nanoseconds);
+      if (CACHED_DYNAMIC_CAST_DETAIL_PROBE_ENABLED(writer_lock))
+        CACHED_DYNAMIC_CAST_DETAIL_PROBE(writer_lock, std::size_t{ 0 }, wait_nanoseconds); // a single "shard"
+      if (std::lock_guard pending_lock{ pending_mutex }; true)
+        publishing_entries.swap(pending_entries);
+      if (publishing_entries.empty())
+        return; // published by another thread in the meantime
+
+      const flat_table* const old_table = current.load(std::memory_order_relaxed);
+      auto new_table = copy_table(old_table);
+      for (const flat_table_slot& entry : publishing_entries)
+        new_table->insert_or_assign(entry.key, entry.offset);
+      publishing_entries.clear(); // keeps the buffer, which goes back to `pending_entries` with the next swap
+      publish(new_table.release());
+    }
+
+    // publishes an empty snapshot
+    void clear()
+    {
+      std::lock_guard publish_lock{ publish_mutex };
+      if (std::lock_guard pending_lock{ pending_mutex }; true)
+        pending_entries.clear();
+      publish(nullptr);
+    }
+
+    [[nodiscard]] cached_dynamic_cast_global_cache_usage usage()
+    {
+      const std::size_t max_size = [this]
+      {
+        std::lock_guard publish_lock{ publish_mutex };
+        return capacity;
+      }();
+
+      snapshot_reclamation::read_guard guard{ snapshot_reclamation::instance() };
+      const flat_table* const table = current.load(std::memory_order_seq_cst);
+      return (table != nullptr) ? cached_dynamic_cast_global_cache_usage{ table->size(), table->bytes_used(), max_size }
+                                : cached_dynamic_cast_global_cache_usage{ 0, 0, max_size };
+    }
+
+    void copy_entries(std::vector<cache_entry>& entries)
+    {
+      snapshot_reclamation::read_guard guard{ snapshot_reclamation::instance() };
+      if (const flat_table* const table = current.load(std::memory_order_seq_cst); table != nullptr)
+        table->for_each([&entries](const cache_key& key, const offset_type offset)
+                        { entries.push_back(cache_entry{ key, offset }); });
+    }
+
+    // both publish a modified copy of the current snapshot
+    void set_capacity(const std::size_t new_capacity)
+    {
+      std::lock_guard publish_lock{ publish_mutex };
+      capacity = new_capacity;
+      if (const flat_table* const old_table = current.load(std::memory_order_relaxed); old_table != nullptr)
+        publish(copy_table(old_table).release());
+    }
+
+    void compact()
+    {
+      std::lock_guard publish_lock{ publish_mutex };
+      if (const flat_table* const old_table = current.load(std::memory_order_relaxed); old_table != nullptr)
+      {
+        auto new_table = copy_table(old_table);
+        new_table->compact();
+        publish(new_table.release());
+      }
+    }
+
+    // publishes a copy of the current snapshot without the matching entries (if there are any),
+    // readers are not blocked at all
+    template<typename Predicate>
+    std::size_t erase_if(const Predicate& predicate)
+    {
+      std::lock_guard publish_lock{ publish_mutex };
+      if (std::lock_guard pending_lock{ pending_mutex }; true)
+        pending_entries.erase(std::remove_if(pending_entries.begin(), pending_entries.end(),
+                                             [&predicate](const flat_table_slot& entry) { return predicate(entry.key); }),
+                              pending_entries.end());
+
+      const flat_table* const old_table = current.load(std::memory_order_relaxed);
+      if (old_table == nullptr)
+        return 0;
+      auto new_table = copy_table(old_table);
+      const std::size_t erased_count = new_table->erase_if(predicate, 0, new_table->slot_count());
+      if (erased_count != 0)
+        publish(new_table.release());
+      return erased_count;
+    }
+
+  private:
+    std::atomic<const flat_table*> current{ nullptr };
+    std::mutex publish_mutex;
+    std::mutex pending_mutex;
+    std::vector<flat_table_slot> pending_entries;
+    std::vector<flat_table_slot> publishing_entries; // guarded by `publish_mutex`, empty outside of `store_many()`
+    std::size_t capacity = global_cache_capacity; // guarded by `publish_mutex`
+    std::shared_ptr<std::pmr::memory_resource> memory; // shared with the retired tables
+
+    // must be called with `publish_mutex` locked
+    [[nodiscard]] std::unique_ptr<flat_table> copy_table(const flat_table* const old_table) const
+    {
+      auto new_table = (old_table != nullptr) ? std::make_unique<flat_table>(*old_table, memory.get())
+                                              : std::make_unique<flat_table>(memory.get());
+      new_table->set_reference_marking(false);
+      new_table->set_max_size(capacity);
+      return new_table;
+    }
+
+    void publish(const flat_table* const new_table)
+    {
+      const flat_table* const old_table = current.exchange(new_table, std::memory_order_seq_cst);
+      if (old_table != nullptr)
+        snapshot_reclamation::instance().retire(std::unique_ptr<const flat_table>{ old_table }, memory);
+    }
+  };
+
+  // the nodes listed in /sys/devices/system/node/possible (like "0" or "0-3"), 1 where that is unknown
+  [[nodiscard]] inline std::size_t numa_node_count()
+  {
+#if defined(__linux__)
+    std::ifstream possible_nodes{ "/sys/devices/system/node/possible" };
+    std::string node_ranges;
+    if (std::getline(possible_nodes, node_ranges))
+    {
+      const std::size_t last_separator = node_ranges.find_last_of("-,");
+      const std::string last_node = node_ranges.substr((last_separator == std::string::npos) ? 0 : last_separator + 1);
+      if (!last_node.empty() && last_node.find_first_not_of("0123456789") == std::string::npos)
+        return std::stoul(last_node) + 1;
+    }
+#endif
+    return 1;
+  }
+
+  // the node a thread runs on changes only when it migrates to another socket, so it is looked up now and then
+  [[nodiscard]] inline unsigned current_numa_node() noexcept
+  {
+    if (numa_node_override >= 0)
+      return static_cast<unsigned>(numa_node_override);
+#if defined(__linux__) && defined(SYS_getcpu)
+    static thread_local unsigned node = 0;
+    static thread_local unsigned lookups_until_refresh = 0;
+    if (lookups_until_refresh-- == 0)
+    {
+      unsigned cpu = 0;
+      unsigned new_node = 0;
+      if (syscall(SYS_getcpu, &cpu, &new_node, nullptr) == 0)
+        node = new_node;
+      lookups_until_refresh = 255;
+    }
+    return node;
+#else
+    return 0;
+#endif
+  }
+
+  // `CACHED_DYNAMIC_CAST_NUMA_REPLICAS`: a `Replica` cache per NUMA node, the node of the calling thread picks the one
+  // it reads and stores into; a replica is created by the first thread of its node that needs it, so that its tables
+  // end up in that node's memory (first touch); stored entries also go to a lock-free ring of the last `numa_log_size`
+  // ones, which the other replicas apply when they miss (one overwritten in the ring before that, or still being
+  // written there, is simply missed there once more); storing never locks anything but the local replica, catching up
+  // only locks the replica that catches up; resets and erasures apply to the ring and then to every replica under its
+  // catch-up lock, so that no replica picks an entry from before them up afterwards
+  template<typename Replica>
+  class numa_replicated_cache
+  {
+  public:
+    explicit numa_replicated_cache(std::pmr::memory_resource* const upstream_memory)
+      : upstream_memory{ upstream_memory }
+      , replica_count{ std::max<std::size_t>(1, (numa_replicas == 1) ? numa_node_count()
+                                                                     : static_cast<std::size_t>(numa_replicas)) }
+      , replicas{ std::make_unique<std::atomic<replica*>[]>(replica_count) }
+      , log{ std::make_unique<log_slot[]>(numa_log_size) }
+    {
+    }
+
+    [[nodiscard]] offset_type find(const cache_key& key)
+    {
+      replica& local = local_replica();
+      const offset_type offset = local.cache.find(key);
+      if (offset != missing_entry_offset ||
+          local.applied_sequence.load(std::memory_order_acquire) == log_sequence.load(std::memory_order_acquire))
+        return offset;
+      apply_log(local);
+      return local.cache.find(key);
+    }
+
+    void store(const cache_key& key, const offset_type offset)
+    {
+      replica& local = local_replica();
+      local.cache.store(key, offset);
+      const cache_entry entry{ key, offset };
+      append_to_log(local, &entry, 1);
+    }
+
+    void store_many(const cache_entry* const entries, const std::size_t count)
+    {
+      replica& local = local_replica();
+      local.cache.store_many(entries, count);
+      append_to_log(local, entries, count);
+    }
+
+    void clear()
+    {
+      std::lock_guard log_lock{ log_mutex };
+      const std::uint64_t sequence = log_sequence.load(std::memory_order_acquire);
+      first_valid_sequence.store(sequence, std::memory_order_release);
+      for (const std::unique_ptr<replica>& each_replica : owned_replicas)
+      {
+        std::lock_guard catch_up_lock{ each_replica->catch_up_mutex };
+        each_replica->cache.clear();
+        each_replica->applied_sequence.store(sequence, std::memory_order_release);
+      }
+    }
+
+    // those of all the replicas, without duplicates
+    void copy_entries(std::vector<cache_entry>& entries) const
+    {
+      std::vector<cache_entry> all_entries;
+      if (std::lock_guard log_lock{ log_mutex }; true)
+        for (const std::unique_ptr<replica>& each_replica : owned_replicas)
+          each_replica->cache.copy_entries(all_entries);
+      const auto key_of = [](const cache_entry& entry)
+      {
+        return std::make_tuple(entry.key.destination_type, entry.key.source_dynamic_key, entry.key.source_static_type);
+      };
+      std::sort(all_entries.begin(), all_entries.end(), [&](const cache_entry& left, const cache_entry& right)
+                { return std::less<>{}(key_of(left), key_of(right)); });
+      all_entries.erase(std::unique(all_entries.begin(), all_entries.end(), [&](const cache_entry& left, const cache_entry& right)
+                                    { return key_of(left) == key_of(right); }),
+                        all_entries.end());
+      entries.insert(entries.end(), all_entries.begin(), all_entries.end());
+    }
+
+    // the entries of the fullest replica, the memory of all of them
+    [[nodiscard]] cached_dynamic_cast_global_cache_usage usage() const
+    {
+      std::lock_guard log_lock{ log_mutex };
+      cached_dynamic_cast_global_cache_usage result{ 0, 0, capacity };
+      for (const std::unique_ptr<replica>& each_replica : owned_replicas)
+      {
+        const cached_dynamic_cast_global_cache_usage replica_usage = each_replica->cache.usage();
+        result.entry_count = std::max(result.entry_count, replica_usage.entry_count);
+        result.bytes_used += replica_usage.bytes_used;
+      }
+      return result;
+    }
+
+    // of every replica, each of them holds all the entries it needs
+    void set_capacity(const std::size_t new_capacity)
+    {
+      std::lock_guard log_lock{ log_mutex };
+      capacity = new_capacity;
+      for (const std::unique_ptr<replica>& each_replica : owned_replicas)
+        each_replica->cache.set_capacity(new_capacity);
+    }
+
+    void compact()
+    {
+      std::lock_guard log_lock{ log_mutex };
+      for (const std::unique_ptr<replica>& each_replica : owned_replicas)
+        each_replica->cache.compact();
+    }
+
+    // returns the number of entries erased from the replica that had most of them
+    template<typename Predicate>
+    std::size_t erase_if(const Predicate& predicate)
+    {
+      std::lock_guard log_lock{ log_mutex };
+      for (std::size_t index = 0; index != numa_log_size; ++index)
+        erase_log_slot_if(log[index], predicate);
+      std::size_t erased_count = 0;
+      for (const std::unique_ptr<replica>& each_replica : owned_replicas)
+      {
+        std::lock_guard catch_up_lock{ each_replica->catch_up_mutex };
+        erased_count = std::max(erased_count, each_replica->cache.erase_if(predicate));
+      }
+      return erased_count;
+    }
+
+  private:
+    static constexpr std::size_t numa_log_size = 4096;
+
+    struct alignas(64) replica
+    {
+      replica(std::pmr::memory_resource* const upstream_memory, const std::size_t index)
+        : cache{ upstream_memory }
+        , index{ index }
+      {
+      }
+
+      Replica cache;
+      const std::size_t index;
+      std::atomic<std::uint64_t> applied_sequence{ 0 }; // the log entries before it are in `cache` (or were erased)
+      std::mutex catch_up_mutex; // held while entries of the log are applied to `cache`, and by resets and erasures
+      std::vector<cache_entry> applying_entries; // guarded by `catch_up_mutex`, keeps its buffer
+    };
+
+    // an entry of the ring, written and read like a seqlock: a writer claims the slot by swapping its stamp for
+    // `busy_stamp`, a reader drops whatever it read if the stamp was not the expected one before and after that
+    struct log_slot
+    {
+      std::atomic<std::uint64_t> stamp{ 0 }; // `s + 1` once the entry with sequence number `s` is in, 0 if erased
+      std::atomic<const std::type_info*> destination_type{ nullptr };
+      std::atomic<const void*> source_dynamic_key{ nullptr };
+      std::atomic<const std::type_info*> source_static_type{ nullptr };
+      std::atomic<offset_type> offset{ impossible_cast_offset };
+      std::atomic<std::size_t> origin{ 0 }; // the index of the replica that stored it, which already has it
+    };
+
+    static constexpr std::uint64_t busy_stamp = std::numeric_limits<std::uint64_t>::max();
+
+    std::pmr::memory_resource* const upstream_memory;
+    const std::size_t replica_count;
+    const std::unique_ptr<std::atomic<replica*>[]> replicas; // null until created, see `local_replica()`
+
+    mutable std::mutex log_mutex; // taken by the creation of replicas, resets, erasures and reports, never by lookups
+    std::vector<std::unique_ptr<replica>> owned_replicas; // guarded by `log_mutex`
+    std::size_t capacity = global_cache_capacity; // guarded by `log_mutex`
+    const std::unique_ptr<log_slot[]> log; // the entry with sequence number `s` is at `s % numa_log_size`
+    std::atomic<std::uint64_t> log_sequence{ 0 }; // of the next entry, taken by writers with a `fetch_add()`
+    std::atomic<std::uint64_t> first_valid_sequence{ 0 }; // the entries before it were stored before the last reset
+
+    [[nodiscard]] replica& local_replica()
+    {
+      const std::size_t index = current_numa_node() % replica_count;
+      replica* const existing_replica = replicas[index].load(std::memory_order_acquire);
+      return (existing_replica != nullptr) ? *existing_replica : create_replica(index);
+    }
+
+    [[nodiscard]] replica& create_replica(const std::size_t index)
+    {
+      std::lock_guard log_lock{ log_mutex };
+      if (replica* const existing_replica = replicas[index].load(std::memory_order_relaxed); existing_replica != nullptr)
+        return *existing_replica;
+
+      auto new_replica = std::make_unique<replica>(upstream_memory, index);
+      if (capacity != global_cache_capacity)
+        new_replica->cache.set_capacity(capacity);
+      // applies the whole log on its first miss
+      new_replica->applied_sequence.store(oldest_applicable_sequence(log_sequence.load(std::memory_order_acquire)),
+                                          std::memory_order_relaxed);
+      replica& created_replica = *owned_replicas.emplace_back(std::move(new_replica));
+      replicas[index].store(&created_replica, std::memory_order_release);
+      return created_replica;
+    }
+
+    [[nodiscard]] std::uint64_t oldest_applicable_sequence(const std::uint64_t sequence) const noexcept
+    {
+      return std::max(first_valid_sequence.load(std::memory_order_acquire),
+                      (sequence > numa_log_size) ? sequence - numa_log_size : 0);
+    }
+
+    void append_to_log(replica& origin, const cache_entry* const entries, const std::size_t count)
+    {
+      if (replica_count == 1)
+        return;
+
+      const std::uint64_t first_sequence = log_sequence.fetch_add(count, std::memory_order_acq_rel);
+      for (std::size_t i = 0; i != count; ++i)
+        write_log_slot(first_sequence + i, entries[i], origin.index);
+      // the origin has these entries already, it skips them if it had applied all the ones before them
+      std::uint64_t expected_sequence = first_sequence;
+      origin.applied_sequence.compare_exchange_strong(expected_sequence, first_sequence + count, std::memory_order_acq_rel);
+    }
+
+    void apply_log(replica& target)
+    {
+      std::lock_guard catch_up_lock{ target.catch_up_mutex };
+      const std::uint64_t sequence = log_sequence.load(std::memory_order_acquire);
+      cache_entry entry{};
+      std::size_t origin = 0;
+      for (std::uint64_t s = std::max(target.applied_sequence.load(std::memory_order_acquire), oldest_applicable_sequence(sequence));
+           s < sequence; ++s)
+      {
+        if (read_log_slot(s, entry, origin) && origin != target.index)
+          target.applying_entries.push_back(entry);
+      }
+      target.cache.store_many(target.applying_entries.data(), target.applying_entries.size());
+      target.applying_entries.clear();
+      target.applied_sequence.store(sequence, std::memory_order_release);
+    }
+
+    // an entry whose slot is being written by someone else (which only happens once the ring wraps around
+    // while a writer is preempted, or during an erasure) is dropped: the other replicas just miss it;
+    // the fields are stored with release, so that a reader seeing any of them also sees the busy stamp
+    void write_log_slot(const std::uint64_t sequence, const cache_entry& entry, const std::size_t origin) noexcept
+    {
+      log_slot& slot = log[sequence % numa_log_size];
+      std::uint64_t stamp = slot.stamp.load(std::memory_order_relaxed);
+      if (stamp == busy_stamp || !slot.stamp.compare_exchange_strong(stamp, busy_stamp, std::memory_order_acquire))
+        return;
+      slot.destination_type.store(entry.key.destination_type, std::memory_order_release);
+      slot.source_dynamic_key.store(entry.key.source_dynamic_key, std::memory_order_release);
+      slot.source_static_type.store(entry.key.source_static_type, std::memory_order_release);
+      slot.offset.store(entry.offset, std::memory_order_release);
+      slot.origin.store(origin, std::memory_order_release);
+      slot.stamp.store(sequence + 1, std::memory_order_release);
+    }
+
+    // false if the entry with this sequence number is not (or no longer, or not yet) in its slot; the fields
+    // are loaded with acquire, so that the stamp is loaded again after them, and has changed if any of them did
+    [[nodiscard]] bool read_log_slot(const std::uint64_t sequence, cache_entry& entry, std::size_t& origin) const noexcept
+    {
+      const log_slot& slot = log[sequence % numa_log_size];
+      if (slot.stamp.load(std::memory_order_acquire) != sequence + 1)
+        return false;
+      entry.key.destination_type = slot.destination_type.load(std::memory_order_acquire);
+      entry.key.source_dynamic_key = slot.source_dynamic_key.load(std::memory_order_acquire);
+      entry.key.source_static_type = slot.source_static_type.load(std::memory_order_acquire);
+      entry.offset = slot.offset.load(std::memory_order_acquire);
+      origin = slot.origin.load(std::memory_order_acquire);
+      return slot.stamp.load(std::memory_order_relaxed) == sequence + 1;
+    }
+
+    template<typename Predicate>
+    void erase_log_slot_if(log_slot& slot, const Predicate& predicate)
+    {
+      std::uint64_t stamp = slot.stamp.load(std::memory_order_relaxed);
+      if (stamp == 0 || stamp == busy_stamp || !slot.stamp.compare_exchange_strong(stamp, busy_stamp, std::memory_order_acquire))
+        return; // a store racing with the erasure may or may not be erased
+      const cache_key key{ slot.destination_type.load(std::memory_order_relaxed),
+                           slot.source_dynamic_key.load(std::memory_order_relaxed),
+                           slot.source_static_type.load(std::memory_order_relaxed) };
+      slot.stamp.store(predicate(key) ? 0 : stamp, std::memory_order_release);
+    }
+  };
+
+#if CACHED_DYNAMIC_CAST_BACKEND == CACHED_DYNAMIC_CAST_BACKEND_LOCKED_TABLE
+  using selected_cache_backend = locked_cache;
+#elif CACHED_DYNAMIC_CAST_BACKEND == CACHED_DYNAMIC_CAST_BACKEND_SNAPSHOT
+  using selected_cache_backend = snapshot_cache;
+#else
+#error unknown CACHED_DYNAMIC_CAST_BACKEND
+#endif
+
+  // the table of one `cast_cache`
+  class cast_cache_storage final
+#if CACHED_DYNAMIC_CAST_NUMA_REPLICAS
+    : public numa_replicated_cache<selected_cache_backend>
+#else
+    : public selected_cache_backend
+#endif
+  {
+  public:
+#if CACHED_DYNAMIC_CAST_NUMA_REPLICAS
+    using numa_replicated_cache::numa_replicated_cache;
+#else
+    using selected_cache_backend::selected_cache_backend;
+#endif
+
+    std::mutex reset_mutex; // keeps the epochs of concurrent resets apart
+  };
+} // namespace detail::cached_dynamic_cast_detail
@@ -0,0 +1,288 @@
+#pragma once
+
+#include "cached_dynamic_cast.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace detail::cached_dynamic_cast_detail
+{
+  // one entry of `flat_table`: the full key and the packed result, 32 bytes so that a slot never straddles
+  // a cache line; `key.destination_type == nullptr` marks an empty slot
+  struct alignas(32) flat_table_slot
+  {
+    cache_key key{};
+    offset_type offset = impossible_cast_offset; // an offset or `impossible_cast_offset`
+    mutable std::atomic<bool> is_referenced{ false }; // CLOCK reference bit, set by (possibly concurrent) lookups
+
+    flat_table_slot() noexcept = default;
+
+    flat_table_slot(const cache_key& key, const offset_type offset) noexcept
+      : key{ key }
+      , offset{ offset }
+    {
+    }
+
+    flat_table_slot(const flat_table_slot& other) noexcept
+      : key{ other.key }
+      , offset{ other.offset }
+      , is_referenced{ other.is_referenced.load(std::memory_order_relaxed) }
+    {
+    }
+
+    flat_table_slot& operator=(const flat_table_slot& other) noexcept
+    {
+      key = other.key;
+      offset = other.offset;
+      is_referenced.store(other.is_referenced.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+    }
+  };
+
+  static_assert(sizeof(flat_table_slot) == 32 || sizeof(void*) != 8);
+
+  // open-addressing hash table with linear probing, keyed by the full (destination, dynamic, static) triple:
+  // a lookup costs one hash computation and a probe sequence over contiguous memory;
+  // with a capacity set, inserting into a full table evicts an entry chosen by the CLOCK algorithm
+  // (entries found since the hand last passed them get a second chance, unless the owner turns the reference
+  // bits off, in which case the hand simply evicts the entries in slot order);
+  // not synchronized in any way except for the reference bits, the owner is responsible for that;
+  // the slots are allocated from a memory resource given by the owner, which must outlive the table
+  class flat_table
+  {
+  public:
+    explicit flat_table(std::pmr::memory_resource* const memory = std::pmr::get_default_resource()) noexcept
+      : slots{ memory }
+    {
+    }
+
+    // a copy with its slots allocated from `memory`
+    flat_table(const flat_table& other, std::pmr::memory_resource* const memory)
+      : slots{ other.slots, memory }
+      , entry_count{ other.entry_count }
+      , capacity{ other.capacity }
+      , clock_hand{ other.clock_hand }
+      , marks_references{ other.marks_references }
+    {
+    }
+
+    // a plain copy would allocate from the default resource
+    flat_table(const flat_table&) = delete;
+    flat_table& operator=(const flat_table&) = delete;
+
+    // returns an offset, `impossible_cast_offset` or `missing_entry_offset`
+    [[nodiscard]] offset_type find(const cache_key& key) const noexcept
+    {
+      if (entry_count == 0)
+        return missing_entry_offset;
+
+      const std::size_t mask = slots.size() - 1;
+      for (std::size_t index = hash_key(key) & mask; ; index = (index + 1) & mask)
+      {
+        const flat_table_slot& slot = slots[index];
+        if (slot.key.destination_type == nullptr)
+          return missing_entry_offset;
+        if (same_key(slot.key, key))
+        {
+          // avoid dirtying the cache line when the bit is not going to be looked at or is set already
+          if (capacity != 0 && marks_references && !slot.is_referenced.load(std::memory_order_relaxed))
+            slot.is_referenced.store(true, std::memory_order_relaxed);
+          return slot.offset;
+        }
+      }
+    }
+
+    void insert_or_assign(const cache_key& key, const offset_type offset)
+    {
+      if (entry_count != 0)
+      {
+        if (flat_table_slot& slot = find_slot(key); slot.key.destination_type != nullptr)
+        {
+          slot.offset = offset;
+          return;
+        }
+      }
+
+      while (capacity != 0 && entry_count >= capacity)
+        evict_one();
+
+      if ((entry_count + 1) * 2 > slots.size()) // keep the load factor at or below 1/2
+        rehash(slots.empty() ? minimum_slot_count : slots.size() * 2);
+
+      find_slot(key) = flat_table_slot{ key, offset };
+      ++entry_count;
+    }
+
+    // keeps the slots, so that refilling the table does not allocate again (`compact()` releases them)
+    void clear() noexcept
+    {
+      std::fill(slots.begin(), slots.end(), flat_table_slot{});
+      entry_count = 0;
+      clock_hand = 0;
+      ++layout_changes;
+    }
+
+    // removes the entries matching `predicate` among `count` slots starting at `first_slot`, returns how many;
+    // an entry moved back into the scanned slots by a removal is looked at as well, so scanning a table
+    // piece by piece visits every entry as long as `layout_version()` stays the same in between
+    template<typename Predicate>
+    std::size_t erase_if(const Predicate& predicate, const std::size_t first_slot, const std::size_t count)
+    {
+      if (first_slot >= slots.size())
+        return 0;
+
+      std::size_t erased_count = 0;
+      const std::size_t last_slot = first_slot + std::min(count, slots.size() - first_slot);
+      for (std::size_t index = first_slot; index < last_slot; )
+      {
+        if (slots[index].key.destination_type != nullptr && predicate(slots[index].key))
+        {
+          erase_at(index);
+          ++erased_count;
+        }
+        else
+        {
+          ++index;
+        }
+      }
+      return erased_count;
+    }
+
+    [[nodiscard]] std::size_t slot_count() const noexcept
+    {
+      return slots.size();
+    }
+
+    // changes whenever entries may have moved between slots (evictions, removals, rehashing, clearing)
+    [[nodiscard]] std::uint64_t layout_version() const noexcept
+    {
+      return layout_changes;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+      return entry_count;
+    }
+
+    template<typename Visitor>
+    void for_each(Visitor&& visitor) const
+    {
+      for (const flat_table_slot& slot : slots)
+        if (slot.key.destination_type != nullptr)
+          visitor(slot.key, slot.offset);
+    }
+
+    // heap memory taken by the slots
+    [[nodiscard]] std::size_t bytes_used() const noexcept
+    {
+      return slots.capacity() * sizeof(flat_table_slot);
+    }
+
+    [[nodiscard]] std::size_t max_size() const noexcept
+    {
+      return capacity;
+    }
+
+    // 0 means unbounded; evicts entries right away if there are more of them than the new capacity
+    void set_max_size(const std::size_t new_capacity) noexcept
+    {
+      capacity = new_capacity;
+      while (capacity != 0 && entry_count > capacity)
+        evict_one();
+    }
+
+    // off: lookups never write to the table, so that readers sharing it do not bounce its cache lines
+    // between cores, at the cost of evicting recently found entries as readily as the others
+    void set_reference_marking(const bool enabled) noexcept
+    {
+      marks_references = enabled;
+    }
+
+    // shrinks the slots to the smallest size that keeps the load factor at or below 1/2
+    void compact()
+    {
+      if (entry_count == 0)
+      {
+        std::pmr::vector<flat_table_slot>{ slots.get_allocator() }.swap(slots);
+        clock_hand = 0;
+        ++layout_changes;
+        return;
+      }
+
+      std::size_t slot_count = minimum_slot_count;
+      while (entry_count * 2 > slot_count)
+        slot_count *= 2;
+      if (slot_count != slots.size())
+        rehash(slot_count);
+    }
+
+  private:
+    static constexpr std::size_t minimum_slot_count = 16;
+
+    std::pmr::vector<flat_table_slot> slots; // the number of slots is always a power of two (or zero)
+    std::size_t entry_count = 0;
+    std::size_t capacity = 0; // the maximum number of entries, 0 means unbounded
+    std::size_t clock_hand = 0; // the next slot the eviction looks at
+    bool marks_references = true; // whether `find()` sets the reference bits
+    std::uint64_t layout_changes = 0;
+
+    // either the slot holding `key` or the empty slot where it should be inserted
+    [[nodiscard]] flat_table_slot& find_slot(const cache_key& key) noexcept
+    {
+      const std::size_t mask = slots.size() - 1;
+      for (std::size_t index = hash_key(key) & mask; ; index = (index + 1) & mask)
+      {
+        flat_table_slot& slot = slots[index];
+        if (slot.key.destination_type == nullptr || same_key(slot.key, key))
+          return slot;
+      }
+    }
+
+    // must not be called on an empty table
+    void evict_one() noexcept
+    {
+      const std::size_t mask = slots.size() - 1;
+      for (;; clock_hand = (clock_hand + 1) & mask)
+      {
+        flat_table_slot& slot = slots[clock_hand];
+        if (slot.key.destination_type != nullptr && !slot.is_referenced.exchange(false, std::memory_order_relaxed))
+          return erase_at(clock_hand);
+      }
+    }
+
+    // backward-shift deletion: the probe sequences stay intact without tombstones
+    void erase_at(const std::size_t index) noexcept
+    {
+      const std::size_t mask = slots.size() - 1;
+      std::size_t hole = index;
+      for (std::size_t next = (hole + 1) & mask; slots[next].key.destination_type != nullptr; next = (next + 1) & mask)
+      {
+        // an entry may fill the hole unless its home slot lies (cyclically) after the hole
+        const std::size_t home = hash_key(slots[next].key) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+          slots[hole] = slots[next];
+          hole = next;
+        }
+      }
+      slots[hole] = flat_table_slot{};
+      --entry_count;
+      ++layout_changes;
+    }
+
+    void rehash(const std::size_t slot_count)
+    {
+      std::pmr::vector<flat_table_slot> old_slots(slot_count, slots.get_allocator());
+      old_slots.swap(slots);
+      clock_hand = 0;
+      ++layout_changes;
+      for (const flat_table_slot& old_slot : old_slots)
+        if (old_slot.key.destination_type != nullptr)
+          find_slot(old_slot.key) = old_slot;
+    }
+  };
+} // namespace detail::cached_dynamic_cast_detail
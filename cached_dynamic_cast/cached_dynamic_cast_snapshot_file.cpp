@@ -0,0 +1,325 @@
+#include "cached_dynamic_cast.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// snapshot file layout (native byte order, no pointers; an import copies the entries into a hash map):
+//   snapshot_header
+//   snapshot_entry[entry_count]
+//   string table: the mangled type names, each terminated by '\0'
+
+namespace detail::cached_dynamic_cast_detail
+{
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::atomic<bool> has_imported_snapshot{ false };
+
+  inline constexpr char snapshot_magic[8] = { 'C', 'D', 'C', 'S', 'N', 'A', 'P', '\0' };
+  inline constexpr std::uint32_t snapshot_format_version = 1;
+  inline constexpr std::uint32_t snapshot_byte_order_mark = 0x01020304;
+
+  struct snapshot_header
+  {
+    char magic[8];
+    std::uint32_t format_version;
+    std::uint32_t byte_order_mark;
+    std::uint32_t pointer_size;
+    std::uint32_t uses_vptr_keys;
+    std::uint64_t build_id_hash;
+    std::uint64_t entry_count;
+    std::uint64_t string_table_size;
+    std::uint64_t checksum; // of everything after the header
+  };
+
+  struct snapshot_entry
+  {
+    std::uint32_t destination_type_name; // offsets into the string table
+    std::uint32_t dynamic_type_name;
+    std::uint32_t source_static_type_name;
+    std::int32_t offset; // an offset or `impossible_cast_offset`
+    std::int64_t vtable_distance; // see `vtable_distance()`
+  };
+
+  static_assert(sizeof(snapshot_header) == 56 && sizeof(snapshot_entry) == 24);
+
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE std::uint64_t fnv1a_hash(const void* const data, const std::size_t size,
+                                                                           std::uint64_t hash = 0xCBF29CE484222325ull) noexcept
+  {
+    const auto* const bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i)
+      hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    return hash;
+  }
+
+  // the `type_info` referenced by the vtable which `key.source_dynamic_key` points to (or is, without vtable keys)
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE const std::type_info& dynamic_type_of(const cache_key& key) noexcept
+  {
+#if CACHED_DYNAMIC_CAST_USE_VPTR_KEYS
+    return *static_cast<const std::type_info* const*>(key.source_dynamic_key)[-1];
+#else
+    return *static_cast<const std::type_info*>(key.source_dynamic_key);
+#endif
+  }
+
+  // tells apart the vtables of one dynamic type (one per base class subobject, plus construction vtables):
+  // within one binary, a vtable lies at a fixed distance from the `type_info` it references
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE std::int64_t vtable_distance(const cache_key& key, const std::type_info& dynamic_type) noexcept
+  {
+#if CACHED_DYNAMIC_CAST_USE_VPTR_KEYS
+    return static_cast<std::int64_t>(reinterpret_cast<std::intptr_t>(key.source_dynamic_key)
+                                   - reinterpret_cast<std::intptr_t>(&dynamic_type));
+#else
+    static_cast<void>(key);
+    static_cast<void>(dynamic_type);
+    return 0;
+#endif
+  }
+
+  // `vtable_distance()` only tells the vtables of a type apart where the vtable and the `type_info` it references
+  // lie in the same module: with vague linkage, the `type_info` may be that of another module, at a distance
+  // that changes from one run to the next; such entries are neither exported nor looked up, and neither is
+  // any entry where the modules cannot be told (no `dl_iterate_phdr()`)
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE bool has_vtable_in_module_of(const cache_key& key, const std::type_info& dynamic_type)
+  {
+#if CACHED_DYNAMIC_CAST_USE_VPTR_KEYS
+    return is_in_ranges(&dynamic_type, module_address_ranges(key.source_dynamic_key));
+#else
+    static_cast<void>(key);
+    static_cast<void>(dynamic_type);
+    return true;
+#endif
+  }
+
+  // GCC marks the names of types with internal linkage, which need not be unique within a program, with a '*'
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE bool has_unique_name(const std::type_info& type) noexcept
+  {
+    return type.name()[0] != '*';
+  }
+
+  // the entries of a type switch pack the index of a handler with the offset, see `pack_type_switch_entry()`;
+  // its tags are told apart by the name of the template, which every name of an instantiation starts with
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE bool is_type_switch_tag(const std::type_info& type) noexcept
+  {
+    static const std::string_view tag_name_prefix = []
+    {
+      constexpr std::string_view template_name = "type_switch_tag";
+      const std::string_view name = typeid(type_switch_tag<>).name();
+      return name.substr(0, name.rfind(template_name) + template_name.size() + 1); // with the start of the arguments
+    }();
+    return std::string_view{ type.name() }.substr(0, tag_name_prefix.size()) == tag_name_prefix;
+  }
+
+  struct imported_key
+  {
+    std::string_view destination_type_name;
+    std::string_view dynamic_type_name;
+    std::string_view source_static_type_name;
+    std::int64_t vtable_distance;
+
+    friend bool operator==(const imported_key& lhs, const imported_key& rhs) noexcept
+    {
+      return lhs.vtable_distance == rhs.vtable_distance
+          && lhs.destination_type_name == rhs.destination_type_name
+          && lhs.dynamic_type_name == rhs.dynamic_type_name
+          && lhs.source_static_type_name == rhs.source_static_type_name;
+    }
+  };
+
+  struct imported_key_hash
+  {
+    std::size_t operator()(const imported_key& key) const noexcept
+    {
+      std::size_t hash = std::hash<std::string_view>{}(key.destination_type_name);
+      hash = hash * 31 + std::hash<std::string_view>{}(key.dynamic_type_name);
+      hash = hash * 31 + std::hash<std::string_view>{}(key.source_static_type_name);
+      return hash * 31 + static_cast<std::size_t>(key.vtable_distance);
+    }
+  };
+
+  struct imported_snapshot
+  {
+    std::string strings; // the string table, viewed by the keys
+    std::unordered_map<imported_key, offset_type, imported_key_hash> entries;
+  };
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::shared_mutex imported_snapshot_mutex;
+  // never moved, the keys view its strings
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE std::unique_ptr<const imported_snapshot> imported_entries;
+
+  // a copy of the header, as the data may be unaligned; empty if invalid
+  [[nodiscard]] CACHED_DYNAMIC_CAST_DETAIL_INLINE std::optional<snapshot_header> validated_header(const void* const data,
+                                                                                                  const std::size_t size,
+                                                                                                  const std::string_view build_id) noexcept
+  {
+    if (size < sizeof(snapshot_header))
+      return std::nullopt;
+    snapshot_header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0
+     || header.format_version != snapshot_format_version
+     || header.byte_order_mark != snapshot_byte_order_mark
+     || header.pointer_size != sizeof(void*)
+     || header.uses_vptr_keys != CACHED_DYNAMIC_CAST_USE_VPTR_KEYS
+     || header.build_id_hash != fnv1a_hash(build_id.data(), build_id.size()))
+      return std::nullopt;
+
+    const std::uint64_t payload_size = size - sizeof(snapshot_header);
+    if (header.entry_count > payload_size / sizeof(snapshot_entry)
+     || header.entry_count * sizeof(snapshot_entry) + header.string_table_size != payload_size)
+      return std::nullopt;
+    if (header.checksum != fnv1a_hash(static_cast<const unsigned char*>(data) + sizeof(snapshot_header),
+                                      static_cast<std::size_t>(payload_size)))
+      return std::nullopt;
+    return header;
+  }
+
+  CACHED_DYNAMIC_CAST_DETAIL_INLINE offset_type find_in_imported_snapshot(const cache_key& key, const std::type_info& dynamic_type)
+  {
+    if (!has_unique_name(dynamic_type) || !has_unique_name(*key.destination_type) || !has_unique_name(*key.source_static_type))
+      return missing_entry_offset;
+
+    const imported_key name_key{ key.destination_type->name(), dynamic_type.name(), key.source_static_type->name(),
+                                 vtable_distance(key, dynamic_type) };
+    offset_type offset = missing_entry_offset;
+    {
+      std::shared_lock reader_lock{ imported_snapshot_mutex };
+      if (imported_entries == nullptr)
+        return missing_entry_offset;
+      const auto entry = imported_entries->entries.find(name_key);
+      if (entry != imported_entries->entries.end())
+        offset = entry->second;
+    }
+    // only for the pairs found, as walking the modules is slow
+    return (offset != missing_entry_offset && has_vtable_in_module_of(key, dynamic_type)) ? offset : missing_entry_offset;
+  }
+} // namespace detail::cached_dynamic_cast_detail
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE std::vector<unsigned char> export_cached_dynamic_cast_snapshot(const std::string_view build_id)
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  std::vector<snapshot_entry> entries;
+  std::string strings;
+  std::unordered_map<const char*, std::uint32_t> string_offsets;
+  const auto string_offset = [&](const std::type_info& type)
+  {
+    const auto [position, is_new] = string_offsets.emplace(type.name(), static_cast<std::uint32_t>(strings.size()));
+    if (is_new)
+      strings.append(type.name()).push_back('\0');
+    return position->second;
+  };
+
+  std::unordered_map<const void*, bool> vtables_in_module; // by dynamic key, walking the modules is slow
+  for (const cache_entry& entry : copy_global_cache_entries())
+  {
+    const std::type_info& dynamic_type = dynamic_type_of(entry.key);
+    if (!has_unique_name(dynamic_type) || !has_unique_name(*entry.key.destination_type)
+     || !has_unique_name(*entry.key.source_static_type) || is_type_switch_tag(*entry.key.destination_type))
+      continue;
+    const auto [vtable_in_module, is_new] = vtables_in_module.emplace(entry.key.source_dynamic_key, false);
+    if (is_new)
+      vtable_in_module->second = has_vtable_in_module_of(entry.key, dynamic_type);
+    if (!vtable_in_module->second)
+      continue;
+    entries.push_back(snapshot_entry{ string_offset(*entry.key.destination_type), string_offset(dynamic_type),
+                                      string_offset(*entry.key.source_static_type), entry.offset,
+                                      vtable_distance(entry.key, dynamic_type) });
+  }
+
+  std::vector<unsigned char> result(sizeof(snapshot_header) + entries.size() * sizeof(snapshot_entry) + strings.size());
+  unsigned char* const payload = result.data() + sizeof(snapshot_header);
+  if (!entries.empty())
+    std::memcpy(payload, entries.data(), entries.size() * sizeof(snapshot_entry));
+  std::memcpy(payload + entries.size() * sizeof(snapshot_entry), strings.data(), strings.size());
+
+  snapshot_header header{};
+  std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+  header.format_version = snapshot_format_version;
+  header.byte_order_mark = snapshot_byte_order_mark;
+  header.pointer_size = sizeof(void*);
+  header.uses_vptr_keys = CACHED_DYNAMIC_CAST_USE_VPTR_KEYS;
+  header.build_id_hash = fnv1a_hash(build_id.data(), build_id.size());
+  header.entry_count = entries.size();
+  header.string_table_size = strings.size();
+  header.checksum = fnv1a_hash(payload, result.size() - sizeof(snapshot_header));
+  std::memcpy(result.data(), &header, sizeof(header));
+  return result;
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE bool export_cached_dynamic_cast_snapshot(const char* const path, const std::string_view build_id)
+{
+  const std::vector<unsigned char> snapshot = export_cached_dynamic_cast_snapshot(build_id);
+  std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+  file.write(reinterpret_cast<const char*>(snapshot.data()), static_cast<std::streamsize>(snapshot.size()));
+  return static_cast<bool>(file.flush());
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE bool import_cached_dynamic_cast_snapshot(const void* const data, const std::size_t size, const std::string_view build_id)
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  const std::optional<snapshot_header> header = validated_header(data, size, build_id);
+  if (!header)
+    return false;
+
+  auto snapshot_pointer = std::make_unique<imported_snapshot>();
+  imported_snapshot& snapshot = *snapshot_pointer;
+  const auto* const entries = static_cast<const unsigned char*>(data) + sizeof(snapshot_header);
+  snapshot.strings.assign(reinterpret_cast<const char*>(entries + header->entry_count * sizeof(snapshot_entry)),
+                          static_cast<std::size_t>(header->string_table_size));
+  if (!snapshot.strings.empty() && snapshot.strings.back() != '\0')
+    return false;
+
+  const auto name_at = [&snapshot](const std::uint32_t offset, std::string_view& name)
+  {
+    if (offset >= snapshot.strings.size())
+      return false;
+    name = std::string_view{ snapshot.strings.c_str() + offset }; // terminated, see above
+    return true;
+  };
+
+  for (std::uint64_t index = 0; index < header->entry_count; ++index)
+  {
+    snapshot_entry entry;
+    std::memcpy(&entry, entries + index * sizeof(snapshot_entry), sizeof(entry)); // the data may be unaligned
+    imported_key key{ {}, {}, {}, entry.vtable_distance };
+    if (!name_at(entry.destination_type_name, key.destination_type_name)
+     || !name_at(entry.dynamic_type_name, key.dynamic_type_name)
+     || !name_at(entry.source_static_type_name, key.source_static_type_name)
+     || entry.offset == missing_entry_offset)
+      return false;
+    snapshot.entries.emplace(key, entry.offset);
+  }
+
+  const bool has_entries = !snapshot.entries.empty();
+  std::unique_lock writer_lock{ imported_snapshot_mutex };
+  imported_entries = std::move(snapshot_pointer);
+  has_imported_snapshot.store(has_entries, std::memory_order_release);
+  return true;
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE bool import_cached_dynamic_cast_snapshot(const char* const path, const std::string_view build_id)
+{
+  std::ifstream file{ path, std::ios::binary };
+  if (!file)
+    return false;
+  const std::vector<char> contents{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+  return import_cached_dynamic_cast_snapshot(contents.data(), contents.size(), build_id);
+}
+
+CACHED_DYNAMIC_CAST_DETAIL_INLINE void discard_imported_cached_dynamic_cast_snapshot()
+{
+  using namespace detail::cached_dynamic_cast_detail;
+  std::unique_lock writer_lock{ imported_snapshot_mutex };
+  has_imported_snapshot.store(false, std::memory_order_release);
+  imported_entries.reset();
+}
@@ -0,0 +1,571 @@
+#include "../cached_dynamic_cast/cached_dynamic_cast.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  template<std::size_t NumberOfBytes>
+  struct DummyOffsetModifyingStruct
+  {
+  public:
+    virtual ~DummyOffsetModifyingStruct() = default;
+
+  private:
+    static_assert(NumberOfBytes > sizeof(void*)); // to compensate the vtable pointer
+    static_assert(NumberOfBytes % sizeof(void*) == 0);
+    std::array<unsigned char, NumberOfBytes - sizeof(void*)> dummy_offset_modifying_data{};
+  };
+
+  class SimpleBase : public DummyOffsetModifyingStruct<24>
+  {
+  public:
+    virtual ~SimpleBase() = default;
+  };
+
+  class SimpleDerived : public DummyOffsetModifyingStruct<48>, public SimpleBase, public DummyOffsetModifyingStruct<56>
+  {
+  };
+
+  template<int Index>
+  class NumberedDerived : public DummyOffsetModifyingStruct<8 * (Index % 4 + 8)>, public SimpleDerived
+  {
+  };
+
+  class OtherSimpleDerived : public DummyOffsetModifyingStruct<64>, public SimpleBase, public DummyOffsetModifyingStruct<72>
+  {
+  };
+
+  class SimpleDerivedFinal final : public DummyOffsetModifyingStruct<40>, public SimpleDerived
+  {
+  };
+
+  // single inheritance chain
+  class SingleBase
+  {
+  public:
+    virtual ~SingleBase() = default;
+  };
+
+  class SingleMiddle : public SingleBase
+  {
+  };
+
+  class SingleLeaf : public SingleMiddle
+  {
+  };
+
+  class SingleOther : public SingleBase
+  {
+  };
+
+  class SingleLeafFinal final : public SingleMiddle
+  {
+  };
+
+  // virtual inheritance hierarchy ("diamond")
+  class A : public DummyOffsetModifyingStruct<40>
+  {
+  public:
+    virtual ~A() = default;
+  };
+
+  class B : public virtual DummyOffsetModifyingStruct<48>, public virtual A, public virtual DummyOffsetModifyingStruct<56>
+  {
+  };
+
+  class C : public virtual DummyOffsetModifyingStruct<64>, public virtual A, public virtual DummyOffsetModifyingStruct<72>
+  {
+  };
+
+  class D : public DummyOffsetModifyingStruct<80>, public B, public DummyOffsetModifyingStruct<96>, public C, public DummyOffsetModifyingStruct<104>
+  {
+  };
+
+  class E : public virtual A
+  {
+  };
+
+  class DFinal final : public D
+  {
+  };
+
+  // the same diamond, registered: the leaf class is not `final` but registered as a leaf
+  class RegisteredA : public DummyOffsetModifyingStruct<40>
+  {
+  public:
+    virtual ~RegisteredA() = default;
+  };
+
+  class RegisteredB : public virtual DummyOffsetModifyingStruct<48>, public virtual RegisteredA, public virtual DummyOffsetModifyingStruct<56>
+  {
+  };
+
+  class RegisteredC : public virtual DummyOffsetModifyingStruct<64>, public virtual RegisteredA, public virtual DummyOffsetModifyingStruct<72>
+  {
+  };
+
+  class RegisteredD : public DummyOffsetModifyingStruct<80>, public RegisteredB, public DummyOffsetModifyingStruct<96>, public RegisteredC, public DummyOffsetModifyingStruct<104>
+  {
+  };
+
+  class RegisteredE : public virtual RegisteredA
+  {
+  };
+
+  class RegisteredDLeaf : public RegisteredD
+  {
+  };
+
+  // the same diamond again, with a row of casts in every class, see `cached_dynamic_cast_intrusive_root`
+  class IntrusiveA : public DummyOffsetModifyingStruct<40>, public cached_dynamic_cast_intrusive<IntrusiveA>
+  {
+  public:
+    virtual ~IntrusiveA() = default;
+  };
+
+  class IntrusiveB : public virtual DummyOffsetModifyingStruct<48>, public virtual IntrusiveA, public virtual DummyOffsetModifyingStruct<56>
+  {
+    CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveB);
+  };
+
+  class IntrusiveC : public virtual DummyOffsetModifyingStruct<64>, public virtual IntrusiveA, public virtual DummyOffsetModifyingStruct<72>
+  {
+    CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveC);
+  };
+
+  class IntrusiveD : public DummyOffsetModifyingStruct<80>, public IntrusiveB, public DummyOffsetModifyingStruct<96>, public IntrusiveC, public DummyOffsetModifyingStruct<104>
+  {
+    CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveD);
+  };
+
+  class IntrusiveE : public virtual IntrusiveA
+  {
+    CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveE);
+  };
+
+  class IntrusiveDFinal final : public IntrusiveD
+  {
+    CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveDFinal);
+  };
+} // namespace
+
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredA);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredB, RegisteredA);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredC, RegisteredA);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredD, RegisteredB, RegisteredC);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredE, RegisteredA);
+CACHED_DYNAMIC_CAST_REGISTER_LEAF_CLASS(RegisteredDLeaf, RegisteredD);
+
+namespace
+{
+
+  // keeps the compiler from optimizing the measured operations away
+  volatile std::uintptr_t benchmark_sink = 0;
+
+  template<typename Pointer>
+  void consume(Pointer const pointer)
+  {
+    benchmark_sink = benchmark_sink + reinterpret_cast<std::uintptr_t>(pointer);
+  }
+
+  // every measurement is repeated, the median is reported along with the relative standard deviation
+  constexpr int repetitions = 11;
+
+  struct measurement
+  {
+    double median; // ns/op
+    double relative_deviation; // of all the repetitions, in percent
+  };
+
+  template<typename Operation>
+  measurement measure_nanoseconds_per_operation(const std::size_t iterations, Operation&& operation,
+                                                const std::size_t operations_per_iteration = 1)
+  {
+    std::array<double, repetitions> samples{};
+    for (double& sample : samples)
+    {
+      const auto t_begin = std::chrono::steady_clock::now();
+      for (std::size_t i = 0; i < iterations; ++i)
+        operation(i);
+      const auto t_end = std::chrono::steady_clock::now();
+      sample = std::chrono::duration<double, std::nano>(t_end - t_begin).count()
+             / static_cast<double>(iterations * operations_per_iteration);
+    }
+
+    double mean = 0;
+    for (const double sample : samples)
+      mean += sample / repetitions;
+    double variance = 0;
+    for (const double sample : samples)
+      variance += (sample - mean) * (sample - mean) / (repetitions - 1);
+
+    std::sort(samples.begin(), samples.end());
+    return measurement{ samples[repetitions / 2], (mean > 0) ? 100 * std::sqrt(variance) / mean : 0 };
+  }
+
+  std::ostream& operator<<(std::ostream& stream, const measurement& result)
+  {
+    return stream << std::right << std::setw(10) << std::fixed << std::setprecision(2) << result.median << " ns/op"
+                  << " +-" << std::setw(5) << std::setprecision(1) << result.relative_deviation << '%';
+  }
+
+  void print_result(const std::string& name, const measurement& result)
+  {
+    std::cout << std::left << std::setw(56) << name << result << '\n';
+  }
+
+  // a row of the suite: `cached_dynamic_cast` in the first column, the standard cast it replaces in the second one
+  void print_comparison(const std::string& name, const measurement& cached_result, const measurement& standard_result)
+  {
+    std::cout << std::left << std::setw(40) << name << cached_result << "  " << standard_result
+              << std::right << std::setw(8) << std::setprecision(1) << standard_result.median / cached_result.median << "x" << '\n';
+  }
+
+  // the objects to cast from, of several dynamic types so that lookups do not always hit the same entry
+  std::vector<std::unique_ptr<SimpleBase>> make_objects()
+  {
+    std::vector<std::unique_ptr<SimpleBase>> objects;
+    objects.push_back(std::make_unique<NumberedDerived<0>>());
+    objects.push_back(std::make_unique<NumberedDerived<1>>());
+    objects.push_back(std::make_unique<NumberedDerived<2>>());
+    objects.push_back(std::make_unique<NumberedDerived<3>>());
+    objects.push_back(std::make_unique<NumberedDerived<4>>());
+    objects.push_back(std::make_unique<NumberedDerived<5>>());
+    objects.push_back(std::make_unique<NumberedDerived<6>>());
+    objects.push_back(std::make_unique<NumberedDerived<7>>());
+    return objects;
+  }
+
+  // ns/op of `cached_dynamic_cast` and of `dynamic_cast` for one hierarchy: `Leaf`, `Unrelated` and `LeafFinal`
+  // derive from `Root`, the casts go from `Root` to the other types
+  template<typename Root, typename Leaf, typename Unrelated, typename LeafFinal>
+  void benchmark_hierarchy(const char* hierarchy_name)
+  {
+    const std::size_t iterations = 1'000'000;
+    const std::size_t miss_iterations = 20'000;
+
+    auto leaf = std::make_shared<Leaf>();
+    LeafFinal leaf_final;
+    Root* const root = leaf.get();
+    Root& root_reference = *leaf;
+    Root* const root_of_final = &leaf_final;
+    const std::shared_ptr<Root> root_shared = leaf;
+
+    reset_cached_dynamic_cast_global_cache();
+
+    std::cout << hierarchy_name << ":" << std::setw(static_cast<int>(40 - std::string{ hierarchy_name }.size())) << ""
+              << std::setw(29) << std::left << "  cached_dynamic_cast" << std::setw(25) << "  dynamic_cast" << '\n';
+
+    print_comparison("  hit", measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(cached_dynamic_cast<Leaf*>(root));
+    }), measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(dynamic_cast<Leaf*>(root));
+    }));
+
+    print_comparison("  negative hit", measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(cached_dynamic_cast<Unrelated*>(root));
+    }), measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(dynamic_cast<Unrelated*>(root));
+    }));
+
+    print_comparison("  final destination, hit", measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(cached_dynamic_cast<LeafFinal*>(root_of_final));
+    }), measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(dynamic_cast<LeafFinal*>(root_of_final));
+    }));
+
+    print_comparison("  final destination, other type", measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(cached_dynamic_cast<LeafFinal*>(root));
+    }), measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(dynamic_cast<LeafFinal*>(root));
+    }));
+
+    print_comparison("  reference, hit", measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(&cached_dynamic_cast<Leaf&>(root_reference));
+    }), measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(&dynamic_cast<Leaf&>(root_reference));
+    }));
+
+    print_comparison("  shared_ptr, hit", measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(cached_dynamic_pointer_cast<Leaf>(root_shared).get());
+    }), measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(std::dynamic_pointer_cast<Leaf>(root_shared).get());
+    }));
+
+    // no reference count is touched, unlike by the casts above
+    print_comparison("  shared_ptr observed, hit", measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(cached_dynamic_observer_cast<Leaf>(root_shared));
+    }), measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(dynamic_cast<Leaf*>(root_shared.get()));
+    }));
+
+    // the object matches the last of three alternatives: one lookup instead of three casts
+    print_comparison("  type switch, third handler", measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      consume(*cached_type_switch(root,
+                                  [](Unrelated& object) { return static_cast<void*>(&object); },
+                                  [](LeafFinal& object) { return static_cast<void*>(&object); },
+                                  [](Leaf& object) { return static_cast<void*>(&object); }));
+    }), measure_nanoseconds_per_operation(iterations, [&](std::size_t)
+    {
+      if (Unrelated* const unrelated = dynamic_cast<Unrelated*>(root))
+        consume(static_cast<void*>(unrelated));
+      else if (LeafFinal* const final_leaf = dynamic_cast<LeafFinal*>(root))
+        consume(static_cast<void*>(final_leaf));
+      else if (Leaf* const leaf_object = dynamic_cast<Leaf*>(root))
+        consume(static_cast<void*>(leaf_object));
+    }));
+
+    // a miss can only be forced by a reset, whose own cost is reported below it
+    print_comparison("  miss (after a reset)", measure_nanoseconds_per_operation(miss_iterations, [&](std::size_t)
+    {
+      reset_cached_dynamic_cast_global_cache();
+      consume(cached_dynamic_cast<Leaf*>(root));
+    }), measure_nanoseconds_per_operation(miss_iterations, [&](std::size_t)
+    {
+      reset_cached_dynamic_cast_global_cache();
+      consume(dynamic_cast<Leaf*>(root));
+    }));
+
+    std::cout << std::left << std::setw(40) << "  the reset alone" << measure_nanoseconds_per_operation(miss_iterations, [&](std::size_t)
+    {
+      reset_cached_dynamic_cast_global_cache();
+    }) << '\n';
+  }
+
+  void benchmark_suite()
+  {
+    benchmark_hierarchy<SingleBase, SingleLeaf, SingleOther, SingleLeafFinal>("single inheritance");
+    benchmark_hierarchy<SimpleBase, SimpleDerived, OtherSimpleDerived, SimpleDerivedFinal>("multiple inheritance");
+    benchmark_hierarchy<A, D, E, DFinal>("virtual diamond");
+    benchmark_hierarchy<RegisteredA, RegisteredD, RegisteredE, RegisteredDLeaf>("registered virtual diamond");
+    // the rows survive the resets: its "miss" is a hit plus the cost of a reset
+    benchmark_hierarchy<IntrusiveA, IntrusiveD, IntrusiveE, IntrusiveDFinal>("intrusive virtual diamond");
+  }
+
+  // compares the original layout of the global cache (three nested maps, every level keyed by `std::type_index`)
+  // against the flat table keyed by `type_info` addresses or vtable pointers and the type matrix, all without
+  // the thread-local cache
+  void benchmark_dynamic_type_keys()
+  {
+    using namespace detail::cached_dynamic_cast_detail;
+
+    using type_index_keyed_cache_type =
+      std::unordered_map<std::type_index,
+                         std::unordered_map<std::type_index,
+                                            std::pair<bool, std::unordered_map<std::type_index, offset_type>>>>;
+
+    const auto objects = make_objects();
+    const std::size_t mask = objects.size() - 1;
+    const std::size_t iterations = 2'000'000;
+
+    const std::type_info& destination_type = typeid(SimpleDerived);
+    const std::type_info& source_static_type = typeid(SimpleBase);
+
+    reset_cached_dynamic_cast_global_cache();
+    type_index_keyed_cache_type type_index_keyed_cache;
+    type_matrix matrix; // as in a build with `CACHED_DYNAMIC_CAST_TYPE_MATRIX`
+    const std::size_t column = dense_cast_id<SimpleBase, SimpleDerived>();
+    for (const auto& object : objects)
+    {
+      const offset_type offset = offset_between(dynamic_cast<SimpleDerived*>(object.get()), object.get());
+      auto& [is_cast_possible, map_source_static_types] = type_index_keyed_cache[destination_type][typeid(*object)];
+      is_cast_possible = true;
+      map_source_static_types[source_static_type] = offset;
+
+      store_in_global_cache(cache_key{ &destination_type, &typeid(*object), &source_static_type }, offset);
+      const void* vptr_key;
+      std::memcpy(&vptr_key, object.get(), sizeof(vptr_key));
+      store_in_global_cache(cache_key{ &destination_type, vptr_key, &source_static_type }, offset);
+      matrix.store(vptr_key, column, 1, offset);
+    }
+
+    std::cout << "global cache lookups (" << objects.size() << " dynamic types):" << '\n';
+
+    print_result("  nested maps, std::type_index keys (no locking)", measure_nanoseconds_per_operation(iterations, [&](std::size_t i)
+    {
+      SimpleBase* const object = objects[i & mask].get();
+      const auto& map_source_dynamic_types = type_index_keyed_cache.find(destination_type)->second;
+      const auto& map_source_static_types = map_source_dynamic_types.find(typeid(*object))->second.second;
+      consume(reinterpret_cast<unsigned char*>(object) + map_source_static_types.find(source_static_type)->second);
+    }));
+
+    print_result("  flat table, type_info address keys", measure_nanoseconds_per_operation(iterations, [&](std::size_t i)
+    {
+      SimpleBase* const object = objects[i & mask].get();
+      const offset_type offset = find_in_global_cache(cache_key{ &destination_type, &typeid(*object), &source_static_type });
+      consume(reinterpret_cast<unsigned char*>(object) + offset);
+    }));
+
+    print_result("  flat table, vtable pointer keys", measure_nanoseconds_per_operation(iterations, [&](std::size_t i)
+    {
+      SimpleBase* const object = objects[i & mask].get();
+      const void* vptr_key;
+      std::memcpy(&vptr_key, object, sizeof(vptr_key));
+      const offset_type offset = find_in_global_cache(cache_key{ &destination_type, vptr_key, &source_static_type });
+      consume(reinterpret_cast<unsigned char*>(object) + offset);
+    }));
+
+    print_result("  type matrix, vtable pointer rows", measure_nanoseconds_per_operation(iterations, [&](std::size_t i)
+    {
+      SimpleBase* const object = objects[i & mask].get();
+      const void* vptr_key;
+      std::memcpy(&vptr_key, object, sizeof(vptr_key));
+      consume(reinterpret_cast<unsigned char*>(object) + matrix.find(vptr_key, column, 1));
+    }));
+
+    print_result("  cached_dynamic_cast (with the thread-local cache)", measure_nanoseconds_per_operation(iterations, [&](std::size_t i)
+    {
+      consume(cached_dynamic_cast<SimpleDerived*>(objects[i & mask].get()));
+    }));
+
+    print_result("  dynamic_cast", measure_nanoseconds_per_operation(iterations, [&](std::size_t i)
+    {
+      consume(dynamic_cast<SimpleDerived*>(objects[i & mask].get()));
+    }));
+  }
+
+  // batch casts against a loop of single casts, over objects stored in runs of the same dynamic type and interleaved
+  void benchmark_batch_casts()
+  {
+    const auto objects = make_objects();
+    const std::size_t count = 1 << 16;
+    const std::size_t rounds = 20;
+
+    for (const bool is_sorted_by_type : { true, false })
+    {
+      std::vector<SimpleBase*> source_pointers(count);
+      for (std::size_t i = 0; i < count; ++i)
+        source_pointers[i] = objects[is_sorted_by_type ? i * objects.size() / count : i % objects.size()].get();
+      std::vector<SimpleDerived*> destination_pointers(count);
+
+      std::cout << "batch casts (" << count << " pointers, " << (is_sorted_by_type ? "runs of one dynamic type" : "interleaved dynamic types") << "):" << '\n';
+
+      print_result("  loop of cached_dynamic_cast", measure_nanoseconds_per_operation(rounds, [&](std::size_t)
+      {
+        for (std::size_t i = 0; i < count; ++i)
+          destination_pointers[i] = cached_dynamic_cast<SimpleDerived*>(source_pointers[i]);
+        consume(destination_pointers[count - 1]);
+      }, count));
+
+      print_result("  cached_dynamic_cast_n", measure_nanoseconds_per_operation(rounds, [&](std::size_t)
+      {
+        cached_dynamic_cast_n<SimpleDerived*>(source_pointers.data(), count, destination_pointers.data());
+        consume(destination_pointers[count - 1]);
+      }, count));
+
+      print_result("  cached_dynamic_cast_filter", measure_nanoseconds_per_operation(rounds, [&](std::size_t)
+      {
+        consume(cached_dynamic_cast_filter<SimpleDerived*>(source_pointers.data(), count, destination_pointers.data()));
+      }, count));
+
+      print_result("  loop of dynamic_cast", measure_nanoseconds_per_operation(rounds, [&](std::size_t)
+      {
+        for (std::size_t i = 0; i < count; ++i)
+          destination_pointers[i] = dynamic_cast<SimpleDerived*>(source_pointers[i]);
+        consume(destination_pointers[count - 1]);
+      }, count));
+    }
+  }
+  // throughput of the global cache alone (no thread-local cache in front of it) for every thread count,
+  // every `miss_period`-th operation inserts a new entry; build with different CACHED_DYNAMIC_CAST_GLOBAL_CACHE_SHARDS;
+  // the threads only contend when they run at the same time, so the numbers for more threads than there are cores
+  // show time slicing rather than lock contention, and sharding cannot make a difference there
+  void benchmark_global_cache_contention()
+  {
+    using namespace detail::cached_dynamic_cast_detail;
+
+    const auto objects = make_objects();
+    const std::size_t operations_per_thread = 1'000'000;
+    const std::size_t miss_period = 16;
+    const std::type_info& destination_type = typeid(SimpleDerived);
+    const std::type_info& source_static_type = typeid(SimpleBase);
+
+    std::cout << "global cache throughput (" << global_cache_shard_count << " shards"
+              << ((numa_replicas > 0) ? ", a replica per NUMA node" : "") << ", 1 miss every " << miss_period << " operations):" << '\n';
+    if (const unsigned core_count = std::thread::hardware_concurrency(); core_count != 0 && core_count < 8)
+      std::cout << "  (" << core_count << " cores: the runs with more threads measure time slicing, not contention)" << '\n';
+
+    for (const std::size_t thread_count : { 1, 2, 4, 8 })
+    {
+      reset_cached_dynamic_cast_global_cache();
+      set_cached_dynamic_cast_global_cache_capacity(1 << 14);
+      for (const auto& object : objects)
+        store_in_global_cache(cache_key{ &destination_type, dynamic_type_key(object.get()), &source_static_type },
+                              offset_between(dynamic_cast<SimpleDerived*>(object.get()), object.get()));
+
+      // keys for the inserts, never looked up by the objects
+      std::vector<unsigned char> miss_keys(thread_count * (operations_per_thread / miss_period));
+
+      const auto t_begin = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (std::size_t t = 0; t < thread_count; ++t)
+      {
+        threads.emplace_back([&, t]
+        {
+          const std::size_t mask = objects.size() - 1;
+          unsigned char* const thread_miss_keys = miss_keys.data() + t * (operations_per_thread / miss_period);
+          for (std::size_t i = 0; i < operations_per_thread; ++i)
+          {
+            if (i % miss_period == 0)
+            {
+              store_in_global_cache(cache_key{ &destination_type, &thread_miss_keys[i / miss_period], &source_static_type }, 0);
+              continue;
+            }
+            SimpleBase* const object = objects[(i + t) & mask].get();
+            const offset_type offset = find_in_global_cache(cache_key{ &destination_type, dynamic_type_key(object), &source_static_type });
+            consume(reinterpret_cast<unsigned char*>(object) + offset);
+          }
+        });
+      }
+      for (std::thread& thread : threads)
+        thread.join();
+      const auto t_end = std::chrono::steady_clock::now();
+
+      const double seconds = std::chrono::duration<double>(t_end - t_begin).count();
+      std::cout << std::left << std::setw(56) << ("  " + std::to_string(thread_count) + " threads")
+                << std::right << std::setw(10) << std::fixed << std::setprecision(2) << static_cast<double>(thread_count * operations_per_thread) / seconds / 1e6
+                << " Mop/s" << '\n';
+    }
+
+    set_cached_dynamic_cast_global_cache_capacity(0);
+    reset_cached_dynamic_cast_global_cache();
+  }
+} // unnamed namespace
+
+int main()
+{
+  benchmark_suite();
+  benchmark_dynamic_type_keys();
+  benchmark_batch_casts();
+  benchmark_global_cache_contention();
+  return 0;
+}
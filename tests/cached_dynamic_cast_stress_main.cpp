@@ -0,0 +1,264 @@
+#include "../cached_dynamic_cast/cached_dynamic_cast.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// usage: cached_dynamic_cast_stress [max threads] [milliseconds per step] [disrupting fraction] [misses|resets|both] [capacity]
+// runs 1, 2, 4 ... max threads; a fraction of them disrupt the others by inserting new entries into the global cache
+// or by resetting it (or erasing entries from it), the rest keep casting and check every result against `dynamic_cast`;
+// exits with 1 if any result was wrong; a capacity below 16 keeps the casters' own entries from fitting in the global cache;
+// the scaling is only meaningful on a machine with at least as many cores as max threads
+
+namespace
+{
+  template<std::size_t NumberOfBytes>
+  struct DummyOffsetModifyingStruct
+  {
+  public:
+    virtual ~DummyOffsetModifyingStruct() = default;
+
+  private:
+    static_assert(NumberOfBytes > sizeof(void*)); // to compensate the vtable pointer
+    static_assert(NumberOfBytes % sizeof(void*) == 0);
+    std::array<unsigned char, NumberOfBytes - sizeof(void*)> dummy_offset_modifying_data{};
+  };
+
+  class SimpleBase : public DummyOffsetModifyingStruct<24>
+  {
+  public:
+    virtual ~SimpleBase() = default;
+  };
+
+  class SimpleDerived : public DummyOffsetModifyingStruct<48>, public SimpleBase, public DummyOffsetModifyingStruct<56>
+  {
+  };
+
+  // even indices derive from `SimpleDerived`, so that half of the casts fail
+  template<int Index>
+  class NumberedDerived : public DummyOffsetModifyingStruct<8 * (Index % 4 + 8)>,
+                          public std::conditional_t<Index % 2 == 0, SimpleDerived, SimpleBase>
+  {
+  };
+
+  struct options
+  {
+    unsigned max_threads = std::max(2u, std::thread::hardware_concurrency());
+    unsigned milliseconds_per_step = 200;
+    double disrupting_fraction = 0.25;
+    bool injects_misses = true;
+    bool injects_resets = true;
+    std::size_t capacity = 1 << 14; // keeps the miss injectors from growing the global cache without limit
+  };
+
+  options parse_options(const int argc, char** const argv)
+  {
+    options result;
+    if (argc > 1)
+      result.max_threads = std::max(1, std::atoi(argv[1]));
+    if (argc > 2)
+      result.milliseconds_per_step = std::max(1, std::atoi(argv[2]));
+    if (argc > 3)
+      result.disrupting_fraction = std::clamp(std::atof(argv[3]), 0.0, 1.0);
+    if (argc > 4)
+    {
+      result.injects_misses = std::strcmp(argv[4], "resets") != 0;
+      result.injects_resets = std::strcmp(argv[4], "misses") != 0;
+    }
+    if (argc > 5)
+      result.capacity = static_cast<std::size_t>(std::max(1, std::atoi(argv[5])));
+    return result;
+  }
+
+  struct source_object
+  {
+    std::unique_ptr<SimpleBase> object;
+    SimpleDerived* expected_result;
+  };
+
+  template<int... Indices>
+  std::vector<source_object> make_objects(std::integer_sequence<int, Indices...>)
+  {
+    std::vector<source_object> objects;
+    (objects.push_back(source_object{ std::make_unique<NumberedDerived<Indices>>(), nullptr }), ...);
+    for (source_object& object : objects)
+      object.expected_result = dynamic_cast<SimpleDerived*>(object.object.get());
+    return objects;
+  }
+
+  struct step_result
+  {
+    std::uint64_t casts = 0;
+    std::uint64_t wrong_results = 0;
+    std::vector<std::uint32_t> sampled_latencies; // nanoseconds
+  };
+
+  // every `latency_sampling_period`-th cast is timed on its own, timing all of them would mostly measure the clock
+  constexpr std::uint64_t latency_sampling_period = 64;
+
+  step_result run_caster(const std::vector<source_object>& objects, const std::atomic<bool>& is_running, const unsigned seed)
+  {
+    step_result result;
+    std::uint64_t random = 0x9E3779B97F4A7C15ull * (seed + 1);
+    while (is_running.load(std::memory_order_relaxed))
+    {
+      for (int i = 0; i < 256; ++i)
+      {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        const source_object& source = objects[random % objects.size()];
+
+        SimpleDerived* cast_result;
+        if (result.casts % latency_sampling_period == 0)
+        {
+          const auto t_begin = std::chrono::steady_clock::now();
+          cast_result = cached_dynamic_cast<SimpleDerived*>(source.object.get());
+          const auto t_end = std::chrono::steady_clock::now();
+          result.sampled_latencies.push_back(static_cast<std::uint32_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_begin).count()));
+        }
+        else
+        {
+          cast_result = cached_dynamic_cast<SimpleDerived*>(source.object.get());
+        }
+
+        result.wrong_results += (cast_result != source.expected_result);
+        ++result.casts;
+      }
+    }
+    return result;
+  }
+
+  // inserts entries that no caster ever looks up, so that the writers compete with the readers for the locks
+  void run_miss_injector(const std::atomic<bool>& is_running, const unsigned seed)
+  {
+    using namespace detail::cached_dynamic_cast_detail;
+    std::vector<unsigned char> fake_dynamic_types(4096);
+    for (std::size_t i = 0; is_running.load(std::memory_order_relaxed); ++i)
+    {
+      const cache_key key{ &typeid(SimpleDerived), &fake_dynamic_types[(i + seed) % fake_dynamic_types.size()], &typeid(SimpleBase) };
+      store_in_global_cache(key, impossible_cast_offset);
+    }
+  }
+
+  // every other time, removes the entries cast to `SimpleDerived` (all of them) piece by piece instead
+  void run_reset_injector(const std::atomic<bool>& is_running)
+  {
+    for (std::size_t i = 0; is_running.load(std::memory_order_relaxed); ++i)
+    {
+      if (i % 2 == 0)
+        reset_cached_dynamic_cast_global_cache();
+      else
+        erase_cached_dynamic_casts_in_address_range(&typeid(SimpleDerived), &typeid(SimpleDerived) + 1);
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  // the threads take turns on the replicas of a `CACHED_DYNAMIC_CAST_NUMA_REPLICAS` build, whatever the machine
+  void spread_over_numa_replicas(const unsigned thread_index)
+  {
+    detail::cached_dynamic_cast_detail::numa_node_override = static_cast<int>(thread_index);
+  }
+
+  std::uint32_t percentile(const std::vector<std::uint32_t>& sorted_values, const double fraction)
+  {
+    if (sorted_values.empty())
+      return 0;
+    return sorted_values[std::min(sorted_values.size() - 1, static_cast<std::size_t>(fraction * sorted_values.size()))];
+  }
+} // unnamed namespace
+
+int main(int argc, char** argv)
+{
+  const options settings = parse_options(argc, argv);
+  const auto objects = make_objects(std::make_integer_sequence<int, 16>{});
+
+  set_cached_dynamic_cast_global_cache_capacity(settings.capacity);
+
+  // the throughput only scales while every thread has a core of its own
+  if (const unsigned core_count = std::thread::hardware_concurrency(); core_count != 0 && core_count < settings.max_threads)
+    std::cout << "(" << core_count << " cores: the runs with more threads measure time slicing, not scaling)" << '\n';
+  std::cout << std::left << std::setw(10) << "threads" << std::setw(12) << "disrupting"
+            << std::right << std::setw(14) << "Mcasts/s" << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns"
+            << std::setw(10) << "p99.9 ns" << '\n';
+
+  std::uint64_t total_wrong_results = 0;
+  for (unsigned thread_count = 1; ; thread_count = std::min(thread_count * 2, settings.max_threads))
+  {
+    // at least one thread always casts
+    const unsigned disrupting_count =
+      std::min(thread_count - 1, static_cast<unsigned>(settings.disrupting_fraction * thread_count + 0.5));
+    const unsigned casting_count = thread_count - disrupting_count;
+
+    reset_cached_dynamic_cast_global_cache();
+    std::atomic<bool> is_running{ true };
+    std::vector<step_result> results(casting_count);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < casting_count; ++t)
+      threads.emplace_back([&, t]
+      {
+        spread_over_numa_replicas(t);
+        results[t] = run_caster(objects, is_running, t);
+      });
+    for (unsigned t = 0; t < disrupting_count; ++t)
+    {
+      const bool injects_resets = settings.injects_resets && (!settings.injects_misses || t % 2 == 1);
+      if (injects_resets)
+        threads.emplace_back([&] { run_reset_injector(is_running); });
+      else
+        threads.emplace_back([&, t]
+        {
+          spread_over_numa_replicas(casting_count + t);
+          run_miss_injector(is_running, t);
+        });
+    }
+
+    const auto t_begin = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(settings.milliseconds_per_step));
+    is_running.store(false, std::memory_order_relaxed);
+    for (std::thread& thread : threads)
+      thread.join();
+    const auto t_end = std::chrono::steady_clock::now();
+
+    std::uint64_t casts = 0;
+    std::vector<std::uint32_t> latencies;
+    for (const step_result& result : results)
+    {
+      casts += result.casts;
+      total_wrong_results += result.wrong_results;
+      latencies.insert(latencies.end(), result.sampled_latencies.begin(), result.sampled_latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    const double seconds = std::chrono::duration<double>(t_end - t_begin).count();
+    std::cout << std::left << std::setw(10) << thread_count << std::setw(12) << disrupting_count
+              << std::right << std::setw(14) << std::fixed << std::setprecision(2) << static_cast<double>(casts) / seconds / 1e6
+              << std::setw(10) << percentile(latencies, 0.5) << std::setw(10) << percentile(latencies, 0.99)
+              << std::setw(10) << percentile(latencies, 0.999) << '\n';
+
+    if (thread_count == settings.max_threads)
+      break;
+  }
+
+  set_cached_dynamic_cast_global_cache_capacity(0);
+
+  if (total_wrong_results != 0)
+  {
+    std::cout << total_wrong_results << " wrong results" << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// usage: cached_dynamic_cast_synthetic_hierarchy_generator <output header> <classes> <max depth> <max direct bases>
+//                                                          <virtual inheritance percent> <seed>
+// writes a header with a random hierarchy of polymorphic classes for cached_dynamic_cast_synthetic_hierarchy_main.cpp:
+// `Class0` is the root, every other class derives from 1..<max direct bases> earlier classes (none of them an
+// ancestor of another one), each of those bases is virtual with the given probability, the root is always a
+// virtual base so that every object has exactly one `Class0` subobject to cast from; every class adds some data
+// to shift the offsets of its bases, some leaves are `final`; a base is skipped if it would make the class contain
+// more than `max_subobjects` subobjects; the same arguments always produce the same header
+
+namespace
+{
+  // splitmix64, so that a seed gives the same hierarchy with any standard library
+  class random_generator
+  {
+  public:
+    explicit random_generator(const std::uint64_t seed) : state{ seed } {}
+
+    std::uint64_t next()
+    {
+      std::uint64_t z = (state += 0x9E3779B97F4A7C15u);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+      return z ^ (z >> 31);
+    }
+
+    std::size_t below(const std::size_t bound) // [0, bound)
+    {
+      return static_cast<std::size_t>(next() % bound);
+    }
+
+  private:
+    std::uint64_t state;
+  };
+
+  struct parameters
+  {
+    std::size_t class_count;
+    std::size_t max_depth;
+    std::size_t max_direct_bases;
+    std::size_t virtual_percent;
+    std::uint64_t seed;
+  };
+
+  // repeated non-virtual bases multiply: without a limit, deep classes would contain thousands of subobjects
+  constexpr std::size_t max_subobjects = 16;
+
+  struct class_description
+  {
+    std::size_t depth = 0; // of the longest path to the root
+    std::vector<std::size_t> direct_bases;
+    std::vector<bool> is_virtual_base;
+    std::size_t non_virtual_subobjects = 1; // the class itself and its non-virtual bases, recursively
+    std::vector<std::size_t> virtual_bases; // direct or not, sorted
+
+    std::size_t data_size = 8;
+    bool is_final = false;
+  };
+
+  // the subobjects of a class with the given direct bases and the given virtual bases (direct or not)
+  std::size_t count_non_virtual_subobjects(const std::vector<class_description>& classes,
+                                           const class_description& description)
+  {
+    std::size_t count = 1;
+    for (std::size_t base = 0; base < description.direct_bases.size(); ++base)
+      if (!description.is_virtual_base[base])
+        count += classes[description.direct_bases[base]].non_virtual_subobjects;
+    return count;
+  }
+
+  std::size_t count_subobjects(const std::vector<class_description>& classes, const class_description& description)
+  {
+    std::size_t count = count_non_virtual_subobjects(classes, description);
+    for (const std::size_t virtual_base : description.virtual_bases)
+      count += classes[virtual_base].non_virtual_subobjects;
+    return count;
+  }
+
+  void add_base(const std::vector<class_description>& classes, class_description& description,
+                const std::size_t base, const bool is_virtual)
+  {
+    description.direct_bases.push_back(base);
+    description.is_virtual_base.push_back(is_virtual);
+    std::vector<std::size_t>& virtual_bases = description.virtual_bases;
+    virtual_bases.insert(virtual_bases.end(), classes[base].virtual_bases.begin(), classes[base].virtual_bases.end());
+    if (is_virtual)
+      virtual_bases.push_back(base);
+    std::sort(virtual_bases.begin(), virtual_bases.end());
+    virtual_bases.erase(std::unique(virtual_bases.begin(), virtual_bases.end()), virtual_bases.end());
+  }
+
+  std::vector<class_description> generate(const parameters& options)
+  {
+    random_generator random{ options.seed };
+    std::vector<class_description> classes(options.class_count);
+    std::vector<std::vector<bool>> is_ancestor(options.class_count, std::vector<bool>(options.class_count, false));
+    std::vector<bool> has_derived(options.class_count, false);
+
+    for (std::size_t index = 1; index < options.class_count; ++index)
+    {
+      class_description& description = classes[index];
+      const std::size_t wanted_bases = 1 + random.below(options.max_direct_bases);
+      for (std::size_t attempt = 0; attempt < 4 * wanted_bases && description.direct_bases.size() < wanted_bases; ++attempt)
+      {
+        // biased towards recent classes, so that the hierarchy gets deep as well as wide
+        const std::size_t candidate = (random.below(2) == 0) ? random.below(index)
+                                                             : index - 1 - random.below(std::min<std::size_t>(index, 8));
+        if (classes[candidate].depth + 1 > options.max_depth)
+          continue;
+        const bool is_related = std::any_of(description.direct_bases.begin(), description.direct_bases.end(),
+                                            [&](const std::size_t base)
+        {
+          return base == candidate || is_ancestor[candidate][base] || is_ancestor[base][candidate];
+        });
+        if (is_related)
+          continue;
+        class_description extended = description;
+        add_base(classes, extended, candidate, candidate == 0 || random.below(100) < options.virtual_percent);
+        if (count_subobjects(classes, extended) <= max_subobjects)
+          description = std::move(extended);
+      }
+      if (description.direct_bases.empty())
+        add_base(classes, description, 0, true);
+      description.non_virtual_subobjects = count_non_virtual_subobjects(classes, description);
+
+      for (const std::size_t base : description.direct_bases)
+      {
+        description.depth = std::max(description.depth, classes[base].depth + 1);
+        is_ancestor[base][index] = true;
+        for (std::size_t ancestor = 0; ancestor < index; ++ancestor)
+          if (is_ancestor[ancestor][base])
+            is_ancestor[ancestor][index] = true;
+        has_derived[base] = true;
+      }
+      description.data_size = 8 * (1 + random.below(4));
+    }
+
+    // only known once all the classes are there
+    random_generator final_random{ options.seed ^ 0xF1A1u };
+    for (std::size_t index = 1; index < options.class_count; ++index)
+      classes[index].is_final = !has_derived[index] && final_random.below(4) == 0;
+    return classes;
+  }
+
+  void write_header(std::ostream& stream, const parameters& options, const std::vector<class_description>& classes)
+  {
+    std::size_t max_depth = 0;
+    std::size_t virtual_base_count = 0;
+    std::size_t base_count = 0;
+    for (const class_description& description : classes)
+    {
+      max_depth = std::max(max_depth, description.depth);
+      base_count += description.direct_bases.size();
+      virtual_base_count += static_cast<std::size_t>(std::count(description.is_virtual_base.begin(),
+                                                                description.is_virtual_base.end(), true));
+    }
+
+    stream << "// generated by cached_dynamic_cast_synthetic_hierarchy_generator, do not edit\n"
+           << "// " << options.class_count << " classes, max depth " << options.max_depth << ", max direct bases "
+           << options.max_direct_bases << ", " << options.virtual_percent << "% virtual, seed " << options.seed << '\n'
+           << "#pragma once\n\n"
+           << "#include <cstddef>\n\n"
+           << "// repeated non-virtual bases are intended: the casts to them fail like to unrelated classes\n"
+           << "#if defined(__GNUC__)\n#pragma GCC diagnostic push\n#pragma GCC diagnostic ignored \"-Winaccessible-base\"\n#endif\n\n"
+           << "namespace synthetic_hierarchy\n{\n"
+           << "  struct Class0\n  {\n    virtual ~Class0() = default;\n    unsigned char data[8];\n  };\n";
+
+    for (std::size_t index = 1; index < classes.size(); ++index)
+    {
+      const class_description& description = classes[index];
+      stream << "\n  struct Class" << index << (description.is_final ? " final" : "") << " : ";
+      for (std::size_t base = 0; base < description.direct_bases.size(); ++base)
+        stream << (base != 0 ? ", " : "") << "public " << (description.is_virtual_base[base] ? "virtual " : "")
+               << "Class" << description.direct_bases[base];
+      stream << "\n  {\n    unsigned char data" << index << '[' << description.data_size << "];\n  };\n";
+    }
+
+    stream << "\n  template<typename... Classes>\n  struct type_list\n  {\n  };\n\n"
+           << "  using classes = type_list<";
+    for (std::size_t index = 0; index < classes.size(); ++index)
+      stream << (index != 0 ? ", " : "") << (index % 16 == 0 && index != 0 ? "\n                           " : "")
+             << "Class" << index;
+    stream << ">;\n\n";
+
+    stream << "  inline constexpr std::size_t class_count = " << classes.size() << ";\n"
+           << "  inline constexpr std::size_t max_direct_bases = " << options.max_direct_bases << ";\n"
+           << "  inline constexpr std::size_t max_depth = " << max_depth << "; // reached\n"
+           << "  inline constexpr std::size_t direct_base_count = " << base_count << ";\n"
+           << "  inline constexpr std::size_t virtual_base_count = " << virtual_base_count << ";\n\n"
+           << "  struct class_info\n  {\n"
+           << "    std::size_t depth;\n"
+           << "    std::size_t direct_base_count;\n"
+           << "    std::size_t direct_bases[max_direct_bases];\n"
+           << "    bool is_final;\n  };\n\n"
+           << "  inline constexpr class_info class_infos[class_count] = {\n";
+    for (const class_description& description : classes)
+    {
+      stream << "    { " << description.depth << ", " << description.direct_bases.size() << ", { ";
+      for (std::size_t base = 0; base < description.direct_bases.size(); ++base)
+        stream << (base != 0 ? ", " : "") << description.direct_bases[base];
+      stream << " }, " << (description.is_final ? "true" : "false") << " },\n";
+    }
+    stream << "  };\n} // namespace synthetic_hierarchy\n\n"
+           << "#if defined(__GNUC__)\n#pragma GCC diagnostic pop\n#endif\n";
+  }
+
+  std::size_t parse_size(const char* const argument, const std::size_t minimum)
+  {
+    return std::max<std::size_t>(minimum, std::strtoull(argument, nullptr, 10));
+  }
+} // unnamed namespace
+
+int main(const int argc, char** const argv)
+{
+  if (argc != 7)
+  {
+    std::cerr << "usage: " << argv[0] << " <output header> <classes> <max depth> <max direct bases>"
+              << " <virtual inheritance percent> <seed>\n";
+    return 2;
+  }
+
+  const parameters options{ parse_size(argv[2], 2),
+                            parse_size(argv[3], 1),
+                            parse_size(argv[4], 1),
+                            std::min<std::size_t>(100, parse_size(argv[5], 0)),
+                            std::strtoull(argv[6], nullptr, 10) };
+
+  const std::vector<class_description> classes = generate(options);
+
+  // written to a temporary file first, so that an interrupted run does not leave a truncated header behind
+  const std::string temporary_path = std::string{ argv[1] } + ".tmp";
+  {
+    std::ofstream stream{ temporary_path, std::ios::trunc };
+    write_header(stream, options, classes);
+    if (!stream)
+    {
+      std::cerr << "cannot write " << temporary_path << '\n';
+      return 1;
+    }
+  }
+  std::remove(argv[1]);
+  if (std::rename(temporary_path.c_str(), argv[1]) != 0)
+  {
+    std::cerr << "cannot rename " << temporary_path << " to " << argv[1] << '\n';
+    return 1;
+  }
+  return 0;
+}
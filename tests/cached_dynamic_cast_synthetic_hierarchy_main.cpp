@@ -0,0 +1,284 @@
+#include "../cached_dynamic_cast/cached_dynamic_cast.hpp"
+#include "synthetic_hierarchy.hpp" // generated at build time, see cached_dynamic_cast_synthetic_hierarchy_generator_main.cpp
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+// usage: cached_dynamic_cast_synthetic_hierarchy [check|check-all|benchmark]
+// casts objects of every class of the generated hierarchy from `Class0*` (the root) to other classes of it;
+// check     - compares `cached_dynamic_cast` (a miss, then a hit) with `dynamic_cast` for every class against
+//             its ancestors and a sample of other classes
+// check-all - the same against all the classes
+// benchmark - global cache memory, miss and hit latency as the number of types in use grows (every result is
+//             compared with `dynamic_cast` outside of the measured loops)
+// with no argument, checks and then benchmarks; exits with 1 if any result was wrong
+
+namespace
+{
+  using synthetic_hierarchy::Class0;
+
+  struct class_functions
+  {
+    Class0* (*make_object)();
+    const volatile void* (*cached_cast)(Class0*);
+    const volatile void* (*standard_cast)(Class0*);
+  };
+
+  template<typename Class>
+  Class0* make_object()
+  {
+    return new Class;
+  }
+
+  template<typename Class>
+  const volatile void* cast_with_cache(Class0* const object)
+  {
+    return cached_dynamic_cast<Class*>(object);
+  }
+
+  template<typename Class>
+  const volatile void* cast_with_dynamic_cast(Class0* const object)
+  {
+    return dynamic_cast<Class*>(object);
+  }
+
+  // indexed like `synthetic_hierarchy::class_infos`
+  template<typename... Classes>
+  std::vector<class_functions> make_class_functions(synthetic_hierarchy::type_list<Classes...>)
+  {
+    return { class_functions{ &make_object<Classes>, &cast_with_cache<Classes>, &cast_with_dynamic_cast<Classes> }... };
+  }
+
+  const std::vector<class_functions> functions = make_class_functions(synthetic_hierarchy::classes{});
+
+  // one object of every class
+  std::vector<std::unique_ptr<Class0>> make_objects()
+  {
+    std::vector<std::unique_ptr<Class0>> objects;
+    objects.reserve(functions.size());
+    for (const class_functions& each_class : functions)
+      objects.emplace_back(each_class.make_object());
+    return objects;
+  }
+
+  // all the classes a class derives from, directly or not, in ascending order
+  std::vector<std::vector<std::size_t>> find_ancestors()
+  {
+    using synthetic_hierarchy::class_infos;
+
+    std::vector<std::vector<std::size_t>> ancestors(synthetic_hierarchy::class_count);
+    for (std::size_t index = 0; index < synthetic_hierarchy::class_count; ++index) // bases always come first
+    {
+      std::vector<std::size_t>& result = ancestors[index];
+      for (std::size_t base = 0; base < class_infos[index].direct_base_count; ++base)
+      {
+        const std::size_t base_index = class_infos[index].direct_bases[base];
+        result.push_back(base_index);
+        result.insert(result.end(), ancestors[base_index].begin(), ancestors[base_index].end());
+      }
+      std::sort(result.begin(), result.end());
+      result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+    return ancestors;
+  }
+
+  struct cast_pair
+  {
+    Class0* object;
+    std::size_t destination;
+  };
+
+  void report_if_wrong(const cast_pair& pair, const std::vector<std::unique_ptr<Class0>>& objects,
+                       const volatile void* const result, std::size_t& error_count)
+  {
+    const volatile void* const expected = functions[pair.destination].standard_cast(pair.object);
+    if (result == expected)
+      return;
+    if (++error_count <= 10)
+    {
+      const auto object_index = static_cast<std::size_t>(
+        std::find_if(objects.begin(), objects.end(), [&](const auto& object) { return object.get() == pair.object; })
+        - objects.begin());
+      std::cout << "wrong result of the cast of a Class" << object_index << " object to Class" << pair.destination
+                << ": " << const_cast<const void*>(result) << " instead of " << const_cast<const void*>(expected) << '\n';
+    }
+  }
+
+  // the pairs of `check()`: every class against itself, its ancestors and `sample_size` random other classes,
+  // or against all the classes if `sample_size` is 0
+  std::vector<cast_pair> make_check_pairs(const std::vector<std::unique_ptr<Class0>>& objects,
+                                          const std::vector<std::vector<std::size_t>>& ancestors,
+                                          const std::size_t sample_size)
+  {
+    std::mt19937 random{ 12345 };
+    std::vector<cast_pair> pairs;
+    for (std::size_t index = 0; index < objects.size(); ++index)
+    {
+      if (sample_size == 0)
+      {
+        for (std::size_t destination = 0; destination < objects.size(); ++destination)
+          pairs.push_back(cast_pair{ objects[index].get(), destination });
+        continue;
+      }
+      pairs.push_back(cast_pair{ objects[index].get(), index });
+      for (const std::size_t ancestor : ancestors[index])
+        pairs.push_back(cast_pair{ objects[index].get(), ancestor });
+      for (std::size_t i = 0; i < sample_size; ++i)
+        pairs.push_back(cast_pair{ objects[index].get(), random() % objects.size() });
+    }
+    std::shuffle(pairs.begin(), pairs.end(), random);
+    return pairs;
+  }
+
+  // every pair is cast twice: the first cast is a miss (unless the pair repeats), the second one a hit
+  std::size_t check(const std::vector<std::unique_ptr<Class0>>& objects,
+                    const std::vector<std::vector<std::size_t>>& ancestors, const std::size_t sample_size)
+  {
+    reset_cached_dynamic_cast_global_cache();
+    const std::vector<cast_pair> pairs = make_check_pairs(objects, ancestors, sample_size);
+
+    std::size_t error_count = 0;
+    std::size_t success_count = 0;
+    for (const cast_pair& pair : pairs)
+    {
+      const volatile void* const result = functions[pair.destination].cached_cast(pair.object);
+      report_if_wrong(pair, objects, result, error_count);
+      success_count += (result != nullptr) ? 1 : 0;
+    }
+    for (const cast_pair& pair : pairs)
+      report_if_wrong(pair, objects, functions[pair.destination].cached_cast(pair.object), error_count);
+
+    std::cout << "checked " << pairs.size() << " casts (" << success_count << " successful) between "
+              << objects.size() << " classes, each twice: " << error_count << " wrong results" << '\n';
+    return error_count;
+  }
+
+  // keeps the compiler from optimizing the measured operations away
+  volatile std::uintptr_t benchmark_sink = 0;
+
+  constexpr int repetitions = 5;
+
+  template<typename Operation>
+  double median_nanoseconds_per_operation(const std::size_t operation_count, Operation&& operation)
+  {
+    std::array<double, repetitions> samples{};
+    for (double& sample : samples)
+    {
+      const auto t_begin = std::chrono::steady_clock::now();
+      operation();
+      const auto t_end = std::chrono::steady_clock::now();
+      sample = std::chrono::duration<double, std::nano>(t_end - t_begin).count() / static_cast<double>(operation_count);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[repetitions / 2];
+  }
+
+  // the first `type_count` classes in use, every one of them cast to itself, to up to 3 of its ancestors
+  // and to other classes in use, 8 destinations per class
+  std::vector<cast_pair> make_benchmark_pairs(const std::vector<std::unique_ptr<Class0>>& objects,
+                                              const std::vector<std::vector<std::size_t>>& ancestors,
+                                              const std::size_t type_count)
+  {
+    constexpr std::size_t destinations_per_type = 8;
+    std::mt19937 random{ static_cast<std::mt19937::result_type>(type_count) };
+    std::vector<cast_pair> pairs;
+    for (std::size_t index = 0; index < type_count; ++index)
+    {
+      pairs.push_back(cast_pair{ objects[index].get(), index });
+      const std::vector<std::size_t>& own_ancestors = ancestors[index]; // all below `index`
+      for (std::size_t i = 0; i < 3 && !own_ancestors.empty(); ++i)
+        pairs.push_back(cast_pair{ objects[index].get(), own_ancestors[random() % own_ancestors.size()] });
+      while (pairs.size() % destinations_per_type != 0)
+        pairs.push_back(cast_pair{ objects[index].get(), random() % type_count });
+    }
+    std::shuffle(pairs.begin(), pairs.end(), random);
+    return pairs;
+  }
+
+  std::size_t benchmark(const std::vector<std::unique_ptr<Class0>>& objects,
+                        const std::vector<std::vector<std::size_t>>& ancestors)
+  {
+    std::cout << synthetic_hierarchy::class_count << " classes, up to " << synthetic_hierarchy::max_depth
+              << " levels deep, " << synthetic_hierarchy::direct_base_count << " direct bases ("
+              << synthetic_hierarchy::virtual_base_count << " virtual); casts from the root, through a function pointer"
+              << '\n'
+              << std::right << std::setw(7) << "types" << std::setw(9) << "pairs" << std::setw(9) << "entries"
+              << std::setw(11) << "table KiB" << std::setw(12) << "bytes/pair"
+              << std::setw(13) << "miss ns/op" << std::setw(12) << "hit ns/op" << std::setw(19) << "dynamic_cast ns/op"
+              << '\n';
+
+    std::size_t error_count = 0;
+    for (std::size_t type_count = std::min<std::size_t>(16, objects.size()); ; type_count = std::min(type_count * 4, objects.size()))
+    {
+      const std::vector<cast_pair> pairs = make_benchmark_pairs(objects, ancestors, type_count);
+      std::vector<const volatile void*> results(pairs.size());
+
+      const double miss_nanoseconds = median_nanoseconds_per_operation(pairs.size(), [&]
+      {
+        reset_cached_dynamic_cast_global_cache(); // cheap next to the misses
+        for (std::size_t i = 0; i < pairs.size(); ++i)
+          results[i] = functions[pairs[i].destination].cached_cast(pairs[i].object);
+      });
+      for (std::size_t i = 0; i < pairs.size(); ++i)
+        report_if_wrong(pairs[i], objects, results[i], error_count);
+      const cached_dynamic_cast_global_cache_usage usage = get_cached_dynamic_cast_global_cache_usage();
+
+      const std::size_t rounds = std::max<std::size_t>(1, (std::size_t{ 1 } << 20) / pairs.size());
+      const auto measure_rounds = [&](const bool is_cached)
+      {
+        return median_nanoseconds_per_operation(rounds * pairs.size(), [&]
+        {
+          for (std::size_t round = 0; round < rounds; ++round)
+            for (const cast_pair& pair : pairs)
+            {
+              const class_functions& destination = functions[pair.destination];
+              const volatile void* const result = is_cached ? destination.cached_cast(pair.object)
+                                                            : destination.standard_cast(pair.object);
+              benchmark_sink = benchmark_sink + reinterpret_cast<std::uintptr_t>(result);
+            }
+        });
+      };
+      const double hit_nanoseconds = measure_rounds(true);
+      const double dynamic_cast_nanoseconds = measure_rounds(false);
+      for (std::size_t i = 0; i < pairs.size(); ++i)
+        report_if_wrong(pairs[i], objects, functions[pairs[i].destination].cached_cast(pairs[i].object), error_count);
+
+      std::cout << std::right << std::fixed << std::setw(7) << type_count << std::setw(9) << pairs.size()
+                << std::setw(9) << usage.entry_count
+                << std::setw(11) << std::setprecision(1) << static_cast<double>(usage.bytes_used) / 1024
+                << std::setw(12) << static_cast<double>(usage.bytes_used) / static_cast<double>(pairs.size())
+                << std::setw(13) << std::setprecision(2) << miss_nanoseconds
+                << std::setw(12) << hit_nanoseconds
+                << std::setw(19) << dynamic_cast_nanoseconds << '\n';
+
+      if (type_count == objects.size())
+        break;
+    }
+    reset_cached_dynamic_cast_global_cache();
+    return error_count;
+  }
+} // unnamed namespace
+
+int main(const int argc, char** const argv)
+{
+  const char* const mode = (argc > 1) ? argv[1] : "";
+  const auto objects = make_objects();
+  const auto ancestors = find_ancestors();
+
+  std::size_t error_count = 0;
+  if (std::strcmp(mode, "benchmark") != 0)
+    error_count += check(objects, ancestors, (std::strcmp(mode, "check-all") == 0) ? 0 : 16);
+  if (mode[0] == '\0' || std::strcmp(mode, "benchmark") == 0)
+    error_count += benchmark(objects, ancestors);
+  return (error_count == 0) ? 0 : 1;
+}
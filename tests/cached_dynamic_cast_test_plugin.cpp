@@ -0,0 +1,44 @@
+// a module loaded and unloaded by `cached_dynamic_cast_tests` (see test_37): it registers classes of its own,
+// whose registrations and `type_info`s live in its memory, and uses the library of the executable loading it
+
+#include "../cached_dynamic_cast/cached_dynamic_cast.hpp"
+
+#include <typeinfo>
+
+namespace
+{
+  class PluginRoot
+  {
+  public:
+    virtual ~PluginRoot();
+  };
+
+  class PluginDerived : public PluginRoot
+  {
+  public:
+    ~PluginDerived() override;
+  };
+
+  PluginRoot::~PluginRoot() = default;
+  PluginDerived::~PluginDerived() = default;
+} // namespace
+
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(PluginRoot);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(PluginDerived, PluginRoot);
+
+extern "C" const std::type_info& cached_dynamic_cast_test_plugin_type()
+{
+  return typeid(PluginDerived);
+}
+
+// casts between the registered classes of the module, true if they all agree with `dynamic_cast`
+extern "C" bool cached_dynamic_cast_test_plugin_casts()
+{
+  PluginDerived derived;
+  PluginRoot root;
+  PluginRoot* const derived_root = &derived;
+  PluginRoot* const root_root = &root;
+  return cached_dynamic_cast<PluginDerived*>(derived_root) == &derived
+      && cached_dynamic_cast<PluginDerived*>(root_root) == nullptr
+      && cached_dynamic_cast<PluginRoot*>(derived_root) == derived_root;
+}
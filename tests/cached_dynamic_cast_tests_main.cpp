@@ -2,11 +2,48 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
 #include <exception>
 #include <stdexcept>
 #include <string>
 #include <iostream>
 #include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+#if CACHED_DYNAMIC_CAST_USDT_PROBES
+#include <sys/sdt.h> // without semaphores: those of the library must not be asked for here
+#endif
+#if defined(CACHED_DYNAMIC_CAST_TEST_PLUGIN)
+#include <dlfcn.h>
+#endif
+
+// types with external linkage, the only ones a cache snapshot can name
+namespace snapshot_test_types
+{
+  struct Base
+  {
+    virtual ~Base() = default;
+  };
+
+  struct OtherBase
+  {
+    virtual ~OtherBase() = default;
+    long other_base_data = 0;
+  };
+
+  struct Derived : OtherBase, Base
+  {
+  };
+
+  struct OtherDerived : Base
+  {
+  };
+} // namespace snapshot_test_types
 
 namespace
 {
@@ -131,6 +168,133 @@ class D : public DummyOffsetModifyingStruct<80>, public B, public DummyOffsetMod
 {
 };
 
+// a family of sibling classes used to produce many distinct cache keys
+template<int Index>
+class NumberedDerived : public DummyOffsetModifyingStruct<8 * (Index % 4 + 4)>, public SimpleBase
+{
+};
+
+// a registered virtual diamond, see `CACHED_DYNAMIC_CAST_REGISTER_CLASS`
+class RegisteredRoot : public DummyOffsetModifyingStruct<40>
+{
+public:
+  virtual ~RegisteredRoot() = default;
+};
+
+class RegisteredLeft : public virtual DummyOffsetModifyingStruct<48>, public virtual RegisteredRoot
+{
+};
+
+class RegisteredRight : public DummyOffsetModifyingStruct<64>, public virtual RegisteredRoot
+{
+};
+
+class RegisteredBottom : public DummyOffsetModifyingStruct<80>, public RegisteredLeft, public RegisteredRight
+{
+};
+
+class RegisteredLeaf : public DummyOffsetModifyingStruct<96>, public RegisteredBottom
+{
+};
+
+class UnregisteredBottom : public RegisteredBottom
+{
+};
+
+// registered with `RegisteredRight` as its only base, `RegisteredLeft` is reached through a base that was not listed
+class RegisteredPartially : public DummyOffsetModifyingStruct<88>, public RegisteredLeft, public RegisteredRight
+{
+};
+
+// an intrusive virtual diamond, see `cached_dynamic_cast_intrusive_root`
+class IntrusiveShape : public DummyOffsetModifyingStruct<40>, public cached_dynamic_cast_intrusive<IntrusiveShape>
+{
+public:
+  virtual ~IntrusiveShape() = default;
+};
+
+class IntrusiveCircle : public DummyOffsetModifyingStruct<48>, public virtual IntrusiveShape
+{
+  CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveCircle);
+};
+
+class IntrusiveSquare : public DummyOffsetModifyingStruct<64>, public virtual IntrusiveShape
+{
+  CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveSquare);
+};
+
+class IntrusiveBadge : public cached_dynamic_cast_intrusive<IntrusiveBadge, IntrusiveCircle>, public IntrusiveSquare, public SimpleBase
+{
+  CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveBadge); // both bases have a row, the class has to pick one
+};
+
+class IntrusiveRing : public DummyOffsetModifyingStruct<80>, public IntrusiveCircle // declares no row of its own
+{
+};
+
+// an intrusive class with two subobjects of the same source type, each in a subobject of the same destination type
+class IntrusiveLabel : public DummyOffsetModifyingStruct<40>, public cached_dynamic_cast_intrusive<IntrusiveLabel>
+{
+public:
+  virtual ~IntrusiveLabel() = default;
+};
+
+class IntrusiveFrame : public DummyOffsetModifyingStruct<48>, public IntrusiveLabel
+{
+  CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveFrame);
+};
+
+template<int Index>
+class IntrusiveFramed : public DummyOffsetModifyingStruct<8 * (Index + 7)>, public IntrusiveFrame
+{
+  CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveFramed);
+};
+
+class IntrusivePair : public IntrusiveFramed<0>, public IntrusiveFramed<1>
+{
+  CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusivePair);
+};
+
+// an intrusive class with a virtual base, which lies elsewhere while the class is constructed as a base of another one
+class IntrusiveNode : public cached_dynamic_cast_intrusive<IntrusiveNode>
+{
+public:
+  virtual ~IntrusiveNode() = default;
+};
+
+class IntrusiveWeight : public DummyOffsetModifyingStruct<40>
+{
+public:
+  virtual ~IntrusiveWeight() = default;
+};
+
+// (one instance per order in which complete and partly constructed objects are first cast from)
+template<int Index>
+class IntrusiveBranch : public IntrusiveNode, public virtual IntrusiveWeight
+{
+  CACHED_DYNAMIC_CAST_INTRUSIVE_CLASS(IntrusiveBranch);
+
+public:
+  IntrusiveWeight* const weight_during_construction = cached_dynamic_cast<IntrusiveWeight*>(static_cast<IntrusiveNode*>(this));
+};
+
+template<int Index>
+class IntrusiveTree : public DummyOffsetModifyingStruct<72>, public virtual IntrusiveWeight, public IntrusiveBranch<Index>
+{
+  std::array<unsigned char, 32> leaves{}; // moves the virtual base further away from the branch
+};
+} // namespace
+
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredRoot);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredLeft, RegisteredRoot);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredRight, RegisteredRoot);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredBottom, RegisteredLeft, RegisteredRight);
+CACHED_DYNAMIC_CAST_REGISTER_LEAF_CLASS(RegisteredLeaf, RegisteredBottom);
+CACHED_DYNAMIC_CAST_REGISTER_CLASS(RegisteredPartially, RegisteredRight);
+
+namespace
+{
+
 static void static_tests()
 {
   reset_cached_dynamic_cast_global_cache();
@@ -659,6 +823,1326 @@ static void test_14() // rvalue shared pointers
   }
 }
 
+template<int DynamicIndex, int... DestinationIndices>
+static void test_15_cast_to_each(SimpleBase* object_pointer)
+{
+  // exactly one of the destinations matches the dynamic type
+  if (((cached_dynamic_cast<NumberedDerived<DestinationIndices>*>(object_pointer) != nullptr) + ...) != 1)
+    THROW_TEST_FAILED();
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<NumberedDerived<DynamicIndex>*>(object_pointer), NumberedDerived<DynamicIndex>);
+}
+
+template<int... Indices>
+static void test_15_all(std::integer_sequence<int, Indices...>)
+{
+  // for each dynamic type, try every destination type
+  (test_15_cast_to_each<Indices, Indices...>(std::make_unique<NumberedDerived<Indices>>().get()), ...);
+}
+
+static void test_15() // more distinct keys than the thread-local cache has entries, so that its slots collide
+{
+  reset_cached_dynamic_cast_global_cache();
+
+  for (int i = 0; i < 3; ++i) // the first pass fills the caches, the next ones reuse (and evict) the entries
+    test_15_all(std::make_integer_sequence<int, 12>{});
+
+  reset_cached_dynamic_cast_global_cache();
+  test_15_all(std::make_integer_sequence<int, 12>{});
+}
+
+static void test_16() // casts from several threads while the global cache is being reset
+{
+  reset_cached_dynamic_cast_global_cache();
+
+  std::atomic<bool> failed{ false };
+  std::vector<std::thread> threads;
+  for (int thread_index = 0; thread_index < 4; ++thread_index)
+  {
+    threads.emplace_back([&failed, thread_index]
+    {
+      SimpleDerivedFromDerived derived;
+      OtherSimpleDerived other_derived;
+      SimpleBase* base_pointers[] = { &derived, &other_derived };
+      for (int i = 0; i < 2'000; ++i)
+      {
+        if (thread_index == 0 && i % 100 == 0)
+          reset_cached_dynamic_cast_global_cache();
+
+        SimpleBase* base_pointer = base_pointers[i % 2];
+        SimpleDerived* result = cached_dynamic_cast<SimpleDerived*>(base_pointer);
+        if (result != dynamic_cast<SimpleDerived*>(base_pointer))
+          failed = true;
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  if (failed)
+    THROW_TEST_FAILED();
+}
+
+static void test_17() // per-call-site caches: monomorphic, polymorphic and megamorphic call sites
+{
+  reset_cached_dynamic_cast_global_cache();
+
+  const int call_site_line = __LINE__;
+  cached_dynamic_cast_call_site<2> call_site{ __FILE__, call_site_line };
+
+  NumberedDerived<0> object_0;
+  NumberedDerived<1> object_1;
+  NumberedDerived<2> object_2;
+  SimpleDerived object_3;
+
+  for (int i = 0; i < 3; ++i) // monomorphic
+    ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<NumberedDerived<0>*>(call_site, static_cast<SimpleBase*>(&object_0)), NumberedDerived<0>);
+
+  for (int i = 0; i < 3; ++i) // polymorphic
+  {
+    ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<NumberedDerived<0>*>(call_site, static_cast<SimpleBase*>(&object_0)), NumberedDerived<0>);
+    ASSERT_NULL(cached_dynamic_cast<NumberedDerived<0>*>(call_site, static_cast<SimpleBase*>(&object_1)));
+  }
+
+  for (int i = 0; i < 3; ++i) // megamorphic
+  {
+    ASSERT_NULL(cached_dynamic_cast<NumberedDerived<0>*>(call_site, static_cast<SimpleBase*>(&object_2)));
+    ASSERT_NULL(cached_dynamic_cast<NumberedDerived<0>*>(call_site, static_cast<SimpleBase*>(&object_3)));
+    ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<NumberedDerived<0>*>(call_site, static_cast<SimpleBase*>(&object_0)), NumberedDerived<0>);
+  }
+
+  ASSERT_NULL(cached_dynamic_cast<NumberedDerived<0>*>(call_site, static_cast<SimpleBase*>(nullptr)));
+
+  bool found = false;
+  for (const cached_dynamic_cast_call_site_statistics& statistics : collect_cached_dynamic_cast_call_site_statistics())
+  {
+    if (statistics.line != static_cast<unsigned>(call_site_line))
+      continue;
+    found = true;
+    if (statistics.dynamic_types != 2 || !statistics.is_megamorphic)
+      THROW_TEST_FAILED();
+#if CACHED_DYNAMIC_CAST_CALL_SITE_COUNTERS
+    // a miss for every first sight of a dynamic type and for every cast from the types that did not fit
+    if (statistics.monomorphic_lookups != 3 || statistics.polymorphic_lookups != 4
+     || statistics.megamorphic_lookups != 3 || statistics.misses != 8)
+      THROW_TEST_FAILED();
+#endif
+  }
+  if (!found)
+    THROW_TEST_FAILED();
+
+  // the entries of the call site are dropped together with the global cache
+  reset_cached_dynamic_cast_global_cache();
+  ASSERT_NULL(cached_dynamic_cast<NumberedDerived<0>*>(call_site, static_cast<SimpleBase*>(&object_1)));
+  for (const cached_dynamic_cast_call_site_statistics& statistics : collect_cached_dynamic_cast_call_site_statistics())
+    if (statistics.line == static_cast<unsigned>(call_site_line) && (statistics.dynamic_types != 1 || statistics.is_megamorphic))
+      THROW_TEST_FAILED();
+
+  // same via the convenience macro
+  SimpleDerivedFromDerived derived;
+  for (SimpleBase* base_pointer : { static_cast<SimpleBase*>(&derived), static_cast<SimpleBase*>(&object_0) })
+  {
+    SimpleDerived* result = CACHED_DYNAMIC_CAST_AT_CALL_SITE(SimpleDerived*, base_pointer);
+    if (result != dynamic_cast<SimpleDerived*>(base_pointer))
+      THROW_TEST_FAILED();
+  }
+}
+
+// a class with two distinct `SimpleBase` subobjects (which also makes `SimpleBase` an ambiguous base)
+class TwoSimpleBases : public SimpleDerived, public OtherSimpleDerived
+{
+};
+
+// casts from `A` to `B` made by the constructor of `B`, both for a complete `B` and for `B` as a part of `D`
+class BCastingItselfWhileConstructed : public virtual DummyOffsetModifyingStruct<48>, public virtual A
+{
+public:
+  BCastingItselfWhileConstructed()
+  {
+    A* object_pointer = this;
+    cast_succeeded = (cached_dynamic_cast<BCastingItselfWhileConstructed*>(object_pointer) == this);
+  }
+
+  bool cast_succeeded = false;
+};
+
+class DerivedFromBCastingItselfWhileConstructed : public DummyOffsetModifyingStruct<80>, public BCastingItselfWhileConstructed
+{
+};
+
+static void test_18() // casts that depend on the subobject pointed to, not just on the dynamic type
+{
+#if CACHED_DYNAMIC_CAST_USE_VPTR_KEYS // `type_info`-keyed entries cannot tell such subobjects apart
+  if (reset_cached_dynamic_cast_global_cache(); true) // two `SimpleBase` subobjects of the same object
+  {
+    TwoSimpleBases object;
+    SimpleBase* first_base_pointer = static_cast<SimpleDerived*>(&object);
+    SimpleBase* second_base_pointer = static_cast<OtherSimpleDerived*>(&object);
+    for (int i = 0; i < 2; ++i)
+    {
+      if (cached_dynamic_cast<TwoSimpleBases*>(first_base_pointer) != &object)
+        THROW_TEST_FAILED();
+      if (cached_dynamic_cast<TwoSimpleBases*>(second_base_pointer) != &object)
+        THROW_TEST_FAILED();
+      if (cached_dynamic_cast<OtherSimpleDerived*>(second_base_pointer) != static_cast<OtherSimpleDerived*>(&object))
+        THROW_TEST_FAILED();
+    }
+  }
+
+  if (reset_cached_dynamic_cast_global_cache(); true) // virtual base class offsets differ while a base class is constructed
+  {
+    for (int i = 0; i < 2; ++i)
+    {
+      BCastingItselfWhileConstructed complete_object;
+      if (!complete_object.cast_succeeded)
+        THROW_TEST_FAILED();
+      DerivedFromBCastingItselfWhileConstructed derived_object;
+      if (!derived_object.cast_succeeded)
+        THROW_TEST_FAILED();
+    }
+  }
+#endif
+}
+
+static void test_19() // tables owned by `cached_dynamic_cast` instantiations
+{
+  reset_cached_dynamic_cast_global_cache();
+
+  SimpleDerived derived;
+  SimpleDerivedFromDerived derived_from_derived;
+  OtherSimpleDerived other_derived;
+  SimpleBase* base_pointers[] = { &derived, &derived_from_derived, &other_derived };
+
+  for (int i = 0; i < 3; ++i)
+    for (SimpleBase* base_pointer : base_pointers)
+      if (cached_dynamic_cast<SimpleDerived*>(base_pointer) != dynamic_cast<SimpleDerived*>(base_pointer))
+        THROW_TEST_FAILED();
+
+#if CACHED_DYNAMIC_CAST_PER_INSTANTIATION_CACHE_SIZE > 0
+  const auto expected_dynamic_types = [](std::size_t count)
+  {
+    using tag = detail::cached_dynamic_cast_detail::per_instantiation_cache_tag<SimpleDerived, SimpleBase>;
+    bool found = false;
+    for (const cached_dynamic_cast_call_site_statistics& statistics : collect_cached_dynamic_cast_call_site_statistics())
+    {
+      if (std::string{ statistics.file } != typeid(tag).name())
+        continue;
+      found = true;
+      if (statistics.dynamic_types != std::min<std::size_t>(count, CACHED_DYNAMIC_CAST_PER_INSTANTIATION_CACHE_SIZE))
+        THROW_TEST_FAILED();
+    }
+    if (!found)
+      THROW_TEST_FAILED();
+  };
+
+  expected_dynamic_types(3);
+
+  reset_cached_dynamic_cast_global_cache();
+  ASSERT_NULL(cached_dynamic_cast<SimpleDerived*>(base_pointers[2]));
+  expected_dynamic_types(1);
+#endif
+}
+
+static void test_20() // batch casts: runs of the same dynamic type, null pointers, blocks and remainders
+{
+  reset_cached_dynamic_cast_global_cache();
+
+  SimpleDerived derived;
+  SimpleDerivedFromDerived derived_from_derived;
+  OtherSimpleDerived other_derived;
+
+  std::vector<const SimpleBase*> base_pointers;
+  for (int run = 0; run < 12; ++run)
+    for (int i = 0; i < run; ++i)
+      base_pointers.push_back(run % 4 == 0 ? static_cast<const SimpleBase*>(&derived)
+                            : run % 4 == 1 ? static_cast<const SimpleBase*>(&derived_from_derived)
+                            : run % 4 == 2 ? static_cast<const SimpleBase*>(&other_derived)
+                            : nullptr);
+
+  std::vector<const SimpleDerived*> derived_pointers(base_pointers.size());
+  cached_dynamic_cast_n<const SimpleDerived*>(base_pointers.data(), base_pointers.size(), derived_pointers.data());
+  for (std::size_t i = 0; i < base_pointers.size(); ++i)
+    if (derived_pointers[i] != dynamic_cast<const SimpleDerived*>(base_pointers[i]))
+      THROW_TEST_FAILED();
+
+  std::vector<const SimpleDerived*> filtered_pointers(base_pointers.size());
+  const std::size_t filtered_count =
+    cached_dynamic_cast_filter<const SimpleDerived*>(base_pointers.data(), base_pointers.size(), filtered_pointers.data());
+  derived_pointers.erase(std::remove(derived_pointers.begin(), derived_pointers.end(), nullptr), derived_pointers.end());
+  if (filtered_count != derived_pointers.size()
+   || !std::equal(derived_pointers.begin(), derived_pointers.end(), filtered_pointers.begin()))
+    THROW_TEST_FAILED();
+
+  std::vector<const SimpleBase*> upcast_pointers(derived_pointers.size());
+  cached_dynamic_cast_n<const SimpleBase*>(derived_pointers.data(), derived_pointers.size(), upcast_pointers.data());
+  for (std::size_t i = 0; i < derived_pointers.size(); ++i)
+    if (upcast_pointers[i] != static_cast<const SimpleBase*>(derived_pointers[i]))
+      THROW_TEST_FAILED();
+}
+
+static void test_21() // bounded global cache: CLOCK eviction, usage reporting, compaction
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  // the shards of the locked table evict independently, every one of them once it holds its share
+#if CACHED_DYNAMIC_CAST_BACKEND == CACHED_DYNAMIC_CAST_BACKEND_LOCKED_TABLE
+  const std::size_t shard_count = global_cache_shard_count;
+#else
+  const std::size_t shard_count = 1;
+#endif
+  // readers of the snapshot backend do not set the reference bits
+  constexpr bool lookups_give_second_chance = (CACHED_DYNAMIC_CAST_BACKEND != CACHED_DYNAMIC_CAST_BACKEND_SNAPSHOT);
+  const auto max_entry_count = [shard_count](std::size_t capacity)
+  {
+    return (capacity + shard_count - 1) / shard_count * shard_count;
+  };
+
+  const std::size_t original_capacity = get_cached_dynamic_cast_global_cache_usage().capacity;
+  reset_cached_dynamic_cast_global_cache();
+  const std::size_t capacity = 4 * shard_count;
+  set_cached_dynamic_cast_global_cache_capacity(capacity);
+
+  static std::vector<int> dynamic_types(8 * shard_count + 64);
+  const auto key = [](std::size_t index)
+  {
+    return cache_key{ &typeid(SimpleDerived), &dynamic_types[index], &typeid(SimpleBase) };
+  };
+
+  for (std::size_t i = 0; i < 2 * capacity; ++i)
+  {
+    store_in_global_cache(key(i), static_cast<offset_type>(i));
+    if (i >= 2 && i < capacity && find_in_global_cache(key(2)) != 2)
+      THROW_TEST_FAILED();
+    if (i >= capacity && lookups_give_second_chance && find_in_global_cache(key(2)) != 2) // gives the entry a second chance
+      THROW_TEST_FAILED();
+  }
+
+  if (get_cached_dynamic_cast_global_cache_usage().entry_count > capacity)
+    THROW_TEST_FAILED();
+  if (lookups_give_second_chance && find_in_global_cache(key(2)) != 2)
+    THROW_TEST_FAILED();
+  if (find_in_global_cache(key(2 * capacity - 1)) != static_cast<offset_type>(2 * capacity - 1))
+    THROW_TEST_FAILED();
+
+  // evicted entries are looked up again, the results stay correct
+  SimpleDerived derived;
+  OtherSimpleDerived other_derived;
+  for (int i = 0; i < 3; ++i)
+  {
+    ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(static_cast<SimpleBase*>(&derived)), SimpleDerived);
+    ASSERT_NULL(cached_dynamic_cast<SimpleDerived*>(static_cast<SimpleBase*>(&other_derived)));
+  }
+
+  set_cached_dynamic_cast_global_cache_capacity(0);
+  for (std::size_t i = 0; i < dynamic_types.size(); ++i)
+    store_in_global_cache(key(i), static_cast<offset_type>(i));
+  const cached_dynamic_cast_global_cache_usage grown_usage = get_cached_dynamic_cast_global_cache_usage();
+  if (grown_usage.entry_count < dynamic_types.size() || grown_usage.capacity != 0)
+    THROW_TEST_FAILED();
+
+  set_cached_dynamic_cast_global_cache_capacity(2);
+  compact_cached_dynamic_cast_global_cache();
+  const cached_dynamic_cast_global_cache_usage compacted_usage = get_cached_dynamic_cast_global_cache_usage();
+  if (compacted_usage.entry_count > max_entry_count(2) || compacted_usage.bytes_used >= grown_usage.bytes_used)
+    THROW_TEST_FAILED();
+
+  set_cached_dynamic_cast_global_cache_capacity(original_capacity);
+  reset_cached_dynamic_cast_global_cache();
+}
+
+static void test_22() // hit, miss and negative hit counters (only when compiled in)
+{
+#if CACHED_DYNAMIC_CAST_STATISTICS > 0
+  reset_cached_dynamic_cast_global_cache();
+  const cached_dynamic_cast_statistics before = cached_dynamic_cast_stats();
+
+  SimpleDerived derived;
+  OtherSimpleDerived other_derived;
+  for (int i = 0; i < 3; ++i)
+    ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(static_cast<SimpleBase*>(&derived)), SimpleDerived);
+  const int other_derived_line = __LINE__ + 2;
+  for (int i = 0; i < 2; ++i)
+    ASSERT_NULL(cached_dynamic_cast<SimpleDerived*>(static_cast<SimpleBase*>(&other_derived)));
+
+  const cached_dynamic_cast_statistics after = cached_dynamic_cast_stats();
+  if (after.hits - before.hits != 2 || after.negative_hits - before.negative_hits != 1 || after.misses - before.misses != 2)
+    THROW_TEST_FAILED();
+  if (after.to_text().find("negative hits: ") == std::string::npos || after.to_json().find("\"misses\":") == std::string::npos)
+    THROW_TEST_FAILED();
+
+#if CACHED_DYNAMIC_CAST_STATISTICS >= 2
+  const auto pair = std::find_if(after.pairs.begin(), after.pairs.end(),
+                                 [other_derived_line](const cached_dynamic_cast_pair_statistics& pair_statistics)
+                                 {
+#if defined(__cpp_lib_source_location)
+                                   if (pair_statistics.file == nullptr || std::string{ pair_statistics.file } != __FILE__
+                                    || pair_statistics.line != static_cast<unsigned>(other_derived_line))
+                                     return false;
+#else
+                                   static_cast<void>(other_derived_line);
+#endif
+                                   return pair_statistics.destination_type == std::string{ typeid(SimpleDerived).name() }
+                                       && pair_statistics.dynamic_type == std::string{ typeid(OtherSimpleDerived).name() };
+                                 });
+  if (pair == after.pairs.end() || pair->negative_hits == 0 || pair->misses == 0)
+    THROW_TEST_FAILED();
+#endif
+
+  // a batch counts what the casts one by one would have, also for the objects answered from a run
+  std::vector<SimpleBase*> batch(11, &derived);
+  batch.insert(batch.end(), 2, nullptr);
+  batch.insert(batch.end(), 9, &other_derived);
+  batch.insert(batch.end(), 3, &derived);
+  std::vector<SimpleDerived*> batch_results(batch.size());
+  cached_dynamic_cast_n(batch.data(), batch.size(), batch_results.data());
+  const cached_dynamic_cast_statistics after_batch = cached_dynamic_cast_stats();
+  if (after_batch.hits - after.hits != 14 || after_batch.negative_hits - after.negative_hits != 9
+   || after_batch.misses != after.misses)
+    THROW_TEST_FAILED();
+#endif
+}
+
+static SimpleDerivedFromDerived prewarm_object;
+CACHED_DYNAMIC_CAST_PREWARM(SimpleDerived, prewarm_object, SimpleBase, DummyOffsetModifyingStruct<80>);
+
+// no default constructor, the warm-up reads a prototype created on its first use
+class PrewarmedDerived : public SimpleDerived
+{
+public:
+  explicit PrewarmedDerived(const int) {}
+};
+
+static const PrewarmedDerived& prewarm_prototype()
+{
+  static const PrewarmedDerived prototype{ 0 };
+  return prototype;
+}
+
+CACHED_DYNAMIC_CAST_PREWARM(OtherSimpleDerived, prewarm_prototype(), SimpleBase);
+
+static void test_23() // warm-up of known cast pairs, registered or explicit
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  const auto find_cached_offset = [](const auto* source_pointer, const std::type_info& destination_type)
+  {
+    using SourceValue = std::remove_cv_t<std::remove_pointer_t<decltype(source_pointer)>>;
+    return find_in_global_cache(cache_key{ &destination_type, dynamic_type_key(source_pointer), &typeid(SourceValue) });
+  };
+  const auto expected_offset = [](const auto* source_pointer, const auto* destination_pointer)
+  {
+    return offset_between(destination_pointer, source_pointer);
+  };
+
+  reset_cached_dynamic_cast_global_cache();
+
+  SimpleDerivedFromDerived derived_from_derived;
+  const SimpleBase* const base = &derived_from_derived;
+  const DummyOffsetModifyingStruct<80>* const other_base = &derived_from_derived;
+  if (find_cached_offset(base, typeid(SimpleDerived)) != missing_entry_offset)
+    THROW_TEST_FAILED();
+
+  prewarm_registered_cached_dynamic_casts(2);
+  if (find_cached_offset(base, typeid(SimpleDerived)) != expected_offset(base, dynamic_cast<const SimpleDerived*>(base))
+   || find_cached_offset(other_base, typeid(SimpleDerived)) != expected_offset(other_base, dynamic_cast<const SimpleDerived*>(other_base)))
+    THROW_TEST_FAILED();
+
+  // impossible casts get entries too, for every object of the dynamic type of the prototype
+  static_assert(!std::is_default_constructible_v<PrewarmedDerived>);
+  const PrewarmedDerived prewarmed{ 1 };
+  if (find_cached_offset(static_cast<const SimpleBase*>(&prewarmed), typeid(OtherSimpleDerived)) != impossible_cast_offset)
+    THROW_TEST_FAILED();
+
+  // an existing object, explicitly
+  SimpleDerived derived;
+  cached_dynamic_cast_prewarm<OtherSimpleDerived, SimpleBase>(derived);
+  if (find_cached_offset(static_cast<const SimpleBase*>(&derived), typeid(OtherSimpleDerived)) != impossible_cast_offset)
+    THROW_TEST_FAILED();
+
+  // an existing object, with virtual bases
+  D object;
+  cached_dynamic_cast_prewarm<C, A, B>(object);
+  const A* const a = &object;
+  const B* const b = &object;
+  if (find_cached_offset(a, typeid(C)) != expected_offset(a, dynamic_cast<const C*>(a))
+   || find_cached_offset(b, typeid(C)) != expected_offset(b, dynamic_cast<const C*>(b)))
+    THROW_TEST_FAILED();
+
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<const SimpleDerived*>(base), SimpleDerivedFromDerived);
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<const C*>(b), D);
+  if (cached_dynamic_cast<const C*>(b) != dynamic_cast<const C*>(b))
+    THROW_TEST_FAILED();
+}
+
+static void test_24() // cache snapshots: export, validation on import, lazy resolution of the imported entries
+{
+  using namespace snapshot_test_types;
+  using namespace detail::cached_dynamic_cast_detail;
+
+  Derived derived;
+  OtherDerived other_derived;
+  Base* const derived_base = &derived;
+  Base* const other_derived_base = &other_derived;
+  const cache_key derived_key{ &typeid(Derived), dynamic_type_key(derived_base), &typeid(Base) };
+  const cache_key other_derived_key{ &typeid(Derived), dynamic_type_key(other_derived_base), &typeid(Base) };
+
+  reset_cached_dynamic_cast_global_cache();
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<Derived*>(derived_base), Derived);
+  ASSERT_NULL(cached_dynamic_cast<Derived*>(other_derived_base));
+  std::vector<unsigned char> snapshot = export_cached_dynamic_cast_snapshot("test build");
+  if (snapshot.empty())
+    THROW_TEST_FAILED();
+
+  // the entries of a type switch do not hold plain offsets, they are left out
+  if (!cached_type_switch(derived_base, [](Derived&) {}, [](Base&) { THROW_TEST_FAILED(); })
+   || export_cached_dynamic_cast_snapshot("test build") != snapshot)
+    THROW_TEST_FAILED();
+
+  reset_cached_dynamic_cast_global_cache();
+  if (import_cached_dynamic_cast_snapshot(snapshot.data(), snapshot.size(), "other build")
+   || import_cached_dynamic_cast_snapshot(snapshot.data(), snapshot.size() - 1, "test build"))
+    THROW_TEST_FAILED();
+  snapshot.back() ^= 1;
+  if (import_cached_dynamic_cast_snapshot(snapshot.data(), snapshot.size(), "test build"))
+    THROW_TEST_FAILED();
+  snapshot.back() ^= 1;
+  std::vector<unsigned char> unaligned_snapshot(snapshot.size() + 1); // like a snapshot at any offset of a buffer
+  std::copy(snapshot.begin(), snapshot.end(), unaligned_snapshot.begin() + 1);
+  if (!import_cached_dynamic_cast_snapshot(unaligned_snapshot.data() + 1, snapshot.size(), "test build"))
+    THROW_TEST_FAILED();
+
+  // nothing is in the cache until the pairs are looked up
+  if (find_in_global_cache(derived_key) != missing_entry_offset || find_in_global_cache(other_derived_key) != missing_entry_offset)
+    THROW_TEST_FAILED();
+#if CACHED_DYNAMIC_CAST_STATISTICS > 0
+  const std::uint64_t misses_before = cached_dynamic_cast_stats().misses;
+#endif
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<Derived*>(derived_base), Derived);
+  ASSERT_NULL(cached_dynamic_cast<Derived*>(other_derived_base));
+  if (cached_dynamic_cast<Derived*>(derived_base) != &derived)
+    THROW_TEST_FAILED();
+#if CACHED_DYNAMIC_CAST_STATISTICS > 0
+  if (cached_dynamic_cast_stats().misses != misses_before)
+    THROW_TEST_FAILED();
+#endif
+  if (find_in_global_cache(derived_key) != offset_between(&derived, derived_base)
+   || find_in_global_cache(other_derived_key) != impossible_cast_offset)
+    THROW_TEST_FAILED();
+
+  // pairs missing from the snapshot still go through `dynamic_cast`
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<OtherBase*>(derived_base), Derived);
+
+  discard_imported_cached_dynamic_cast_snapshot();
+  reset_cached_dynamic_cast_global_cache();
+}
+
+static void test_25() // independent cache domains: own tables and resets, the same results
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  cast_cache first_domain;
+  cast_cache second_domain{ 1024 }; // large enough for no shard to evict anything below
+  if (second_domain.usage().capacity != 1024 || &default_cast_cache() == &first_domain)
+    THROW_TEST_FAILED();
+
+  SimpleDerivedFromDerived derived_from_derived;
+  SimpleBase* const base = &derived_from_derived;
+  OtherSimpleDerived other_derived;
+  SimpleBase* const other_base = &other_derived;
+  const cache_key key{ &typeid(SimpleDerived), dynamic_type_key(base), &typeid(SimpleBase) };
+  const cache_key other_key{ &typeid(SimpleDerived), dynamic_type_key(other_base), &typeid(SimpleBase) };
+
+  reset_cached_dynamic_cast_global_cache();
+  // naming the default domain bypasses the per-instantiation caches, so the entry surely lands in its table
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(default_cast_cache(), base), SimpleDerivedFromDerived);
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(first_domain, base), SimpleDerivedFromDerived);
+  ASSERT_NULL(cached_dynamic_cast<SimpleDerived*>(first_domain, other_base));
+  ASSERT_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived&>(second_domain, *base), SimpleDerivedFromDerived);
+  ASSERT_THROWS_BAD_CAST(cached_dynamic_cast<SimpleDerived&>(second_domain, *other_base));
+  if (cached_dynamic_cast<const SimpleDerived*>(first_domain, static_cast<const SimpleBase*>(base))
+   != static_cast<const SimpleDerived*>(&derived_from_derived))
+    THROW_TEST_FAILED();
+  ASSERT_NULL(cached_dynamic_cast<SimpleDerived*>(first_domain, static_cast<SimpleBase*>(nullptr)));
+  if (cached_dynamic_cast<SimpleBase*>(first_domain, &other_derived) != other_base) // an upcast, nothing to cache
+    THROW_TEST_FAILED();
+
+  const std::shared_ptr<SimpleBase> shared_base = std::make_shared<SimpleDerived>();
+  if (cached_dynamic_pointer_cast<SimpleDerived>(second_domain, shared_base).get() != dynamic_cast<SimpleDerived*>(shared_base.get())
+   || cached_dynamic_pointer_cast<OtherSimpleDerived>(second_domain, std::shared_ptr<SimpleBase>{ shared_base }) != nullptr)
+    THROW_TEST_FAILED();
+
+  // every domain holds the entries of its own casts only
+  if (first_domain.find(key) != offset_between(static_cast<SimpleDerived*>(&derived_from_derived), base)
+   || first_domain.find(other_key) != impossible_cast_offset
+   || second_domain.find(other_key) != impossible_cast_offset
+   || find_in_global_cache(other_key) != missing_entry_offset
+   || first_domain.usage().entry_count != 2)
+    THROW_TEST_FAILED();
+
+  // resets do not reach the other domains
+  first_domain.reset();
+  if (first_domain.find(key) != missing_entry_offset || second_domain.find(key) == missing_entry_offset
+   || find_in_global_cache(key) == missing_entry_offset)
+    THROW_TEST_FAILED();
+  reset_cached_dynamic_cast_global_cache();
+  if (second_domain.find(key) == missing_entry_offset || find_in_global_cache(key) != missing_entry_offset)
+    THROW_TEST_FAILED();
+
+  // an entry of the thread-local cache is only used by the domain which stored it
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(first_domain, base), SimpleDerivedFromDerived);
+  first_domain.reset();
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(first_domain, base), SimpleDerivedFromDerived);
+  if (first_domain.find(key) == missing_entry_offset)
+    THROW_TEST_FAILED();
+}
+
+class counting_memory_resource final : public std::pmr::memory_resource
+{
+public:
+  std::size_t allocation_count = 0;
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    ++allocation_count;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override
+  {
+    std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+  }
+
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+static void test_26() // the tables of a domain come from the given memory, refilling them after a reset allocates nothing
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  static std::vector<int> dynamic_types(32);
+  const auto key = [](std::size_t index)
+  {
+    return cache_key{ &typeid(SimpleDerived), &dynamic_types[index], &typeid(SimpleBase) };
+  };
+
+  counting_memory_resource memory;
+  cast_cache domain{ 0, &memory };
+  for (std::size_t i = 0; i < dynamic_types.size(); ++i)
+    domain.store(key(i), static_cast<offset_type>(i));
+  if (memory.allocation_count == 0)
+    THROW_TEST_FAILED();
+
+  domain.reset();
+  const std::size_t allocation_count = memory.allocation_count;
+  for (std::size_t i = 0; i < dynamic_types.size(); ++i)
+    domain.store(key(i), static_cast<offset_type>(i));
+  for (std::size_t i = 0; i < dynamic_types.size(); ++i)
+    if (domain.find(key(i)) != static_cast<offset_type>(i))
+      THROW_TEST_FAILED();
+  if (memory.allocation_count != allocation_count)
+    THROW_TEST_FAILED();
+
+  SimpleDerived derived;
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(domain, static_cast<SimpleBase*>(&derived)), SimpleDerived);
+}
+
+class IntrusiveBase
+{
+public:
+  virtual ~IntrusiveBase() = default;
+  int reference_count = 0;
+};
+
+// not inlined: otherwise GCC follows the deletion into a caller holding two references to the object
+// and reports the release of the second one as a use after free
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void release_intrusive_reference(IntrusiveBase* const object) noexcept
+{
+  if (--object->reference_count == 0)
+    delete object;
+}
+
+class IntrusiveDerived : public DummyOffsetModifyingStruct<48>, public IntrusiveBase
+{
+};
+
+class OtherIntrusiveDerived : public IntrusiveBase
+{
+};
+
+// a minimal intrusive reference-counted pointer, single-threaded
+template<typename T>
+class test_intrusive_pointer
+{
+public:
+  test_intrusive_pointer() noexcept = default;
+
+  explicit test_intrusive_pointer(T* const object, const bool adds_reference = true) noexcept
+    : object{ object }
+  {
+    if (object != nullptr && adds_reference)
+      ++object->reference_count;
+  }
+
+  test_intrusive_pointer(const test_intrusive_pointer& other) noexcept
+    : test_intrusive_pointer{ other.object }
+  {
+  }
+
+  test_intrusive_pointer(test_intrusive_pointer&& other) noexcept
+    : object{ other.release() }
+  {
+  }
+
+  test_intrusive_pointer& operator=(test_intrusive_pointer other) noexcept
+  {
+    std::swap(object, other.object);
+    return *this;
+  }
+
+  ~test_intrusive_pointer()
+  {
+    if (object != nullptr)
+      release_intrusive_reference(object);
+  }
+
+  [[nodiscard]] T* get() const noexcept
+  {
+    return object;
+  }
+
+  T* release() noexcept
+  {
+    return std::exchange(object, nullptr);
+  }
+
+private:
+  T* object = nullptr;
+};
+} // unnamed namespace
+
+template<typename T>
+struct cached_dynamic_cast_intrusive_pointer_traits<test_intrusive_pointer<T>>
+{
+  template<typename U>
+  using rebind = test_intrusive_pointer<U>;
+
+  static T* get(const test_intrusive_pointer<T>& pointer) noexcept
+  {
+    return pointer.get();
+  }
+
+  template<typename U>
+  static test_intrusive_pointer<U> share(const test_intrusive_pointer<T>&, U* const object) noexcept
+  {
+    return test_intrusive_pointer<U>{ object };
+  }
+
+  template<typename U>
+  static test_intrusive_pointer<U> transfer(test_intrusive_pointer<T>&& source, U* const object) noexcept
+  {
+    static_cast<void>(source.release());
+    return test_intrusive_pointer<U>{ object, false };
+  }
+};
+
+namespace
+{
+static void test_27() // unique, weak and intrusive pointers, plain pointers observing smart pointers
+{
+  // `std::unique_ptr`: the ownership moves on success only
+  std::unique_ptr<SimpleBase> unique_base = std::make_unique<SimpleDerived>();
+  SimpleBase* const base = unique_base.get();
+  if (cached_dynamic_observer_cast<SimpleDerived>(unique_base) != dynamic_cast<SimpleDerived*>(base))
+    THROW_TEST_FAILED();
+  const std::unique_ptr<OtherSimpleDerived> unique_other_derived = cached_dynamic_pointer_cast<OtherSimpleDerived>(std::move(unique_base));
+  if (unique_other_derived != nullptr || unique_base.get() != base)
+    THROW_TEST_FAILED();
+  const std::unique_ptr<SimpleDerived> unique_derived = cached_dynamic_pointer_cast<SimpleDerived>(std::move(unique_base));
+  if (unique_derived.get() != dynamic_cast<SimpleDerived*>(base) || unique_base != nullptr)
+    THROW_TEST_FAILED();
+
+  // a custom deleter is moved along
+  int deleted_count = 0;
+  const auto counting_deleter = [&deleted_count](SimpleBase* const object)
+  {
+    ++deleted_count;
+    delete object;
+  };
+  std::unique_ptr<SimpleBase, decltype(counting_deleter)> unique_counted_base{ new SimpleDerivedFromDerived, counting_deleter };
+  if (cached_dynamic_pointer_cast<OtherSimpleDerived>(std::move(unique_counted_base)) != nullptr || unique_counted_base == nullptr)
+    THROW_TEST_FAILED();
+  if (auto unique_counted_derived = cached_dynamic_pointer_cast<SimpleDerived>(std::move(unique_counted_base));
+      unique_counted_derived == nullptr || unique_counted_base != nullptr)
+    THROW_TEST_FAILED();
+  if (deleted_count != 1)
+    THROW_TEST_FAILED();
+
+  // `std::shared_ptr` observed, `std::weak_ptr` locked
+  const std::shared_ptr<SimpleBase> shared_base = std::make_shared<SimpleDerived>();
+  if (cached_dynamic_observer_cast<SimpleDerived>(shared_base) != dynamic_cast<SimpleDerived*>(shared_base.get())
+   || cached_dynamic_observer_cast<OtherSimpleDerived>(shared_base) != nullptr)
+    THROW_TEST_FAILED();
+  ASSERT_USE_COUNT_EQUALS(shared_base, 1);
+  std::weak_ptr<SimpleBase> weak_base = shared_base;
+  if (const std::shared_ptr<SimpleDerived> locked_derived = cached_dynamic_pointer_cast<SimpleDerived>(weak_base); true)
+  {
+    ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(locked_derived.get(), SimpleDerived);
+    ASSERT_USE_COUNT_EQUALS(locked_derived, 2);
+  }
+  ASSERT_NULL(cached_dynamic_pointer_cast<OtherSimpleDerived>(weak_base).get());
+  ASSERT_USE_COUNT_EQUALS(shared_base, 1);
+  weak_base.reset();
+  ASSERT_NULL(cached_dynamic_pointer_cast<SimpleDerived>(weak_base).get());
+
+  // intrusive pointers: an lvalue gets one more reference, an rvalue hands its reference over on success only
+  test_intrusive_pointer<IntrusiveBase> intrusive_base{ new IntrusiveDerived };
+  IntrusiveBase* const intrusive_object = intrusive_base.get();
+  const test_intrusive_pointer<IntrusiveDerived> intrusive_derived = cached_dynamic_pointer_cast<IntrusiveDerived>(intrusive_base);
+  if (intrusive_derived.get() != dynamic_cast<IntrusiveDerived*>(intrusive_object) || intrusive_object->reference_count != 2)
+    THROW_TEST_FAILED();
+  if (cached_dynamic_pointer_cast<OtherIntrusiveDerived>(intrusive_base).get() != nullptr
+   || cached_dynamic_observer_cast<IntrusiveDerived>(intrusive_base) != intrusive_derived.get()
+   || intrusive_object->reference_count != 2)
+    THROW_TEST_FAILED();
+  if (cached_dynamic_pointer_cast<OtherIntrusiveDerived>(std::move(intrusive_base)).get() != nullptr
+   || intrusive_base.get() != intrusive_object || intrusive_object->reference_count != 2)
+    THROW_TEST_FAILED();
+  const test_intrusive_pointer<IntrusiveDerived> moved_intrusive_derived = cached_dynamic_pointer_cast<IntrusiveDerived>(std::move(intrusive_base));
+  if (moved_intrusive_derived.get() != intrusive_derived.get() || intrusive_base.get() != nullptr
+   || intrusive_object->reference_count != 2)
+    THROW_TEST_FAILED();
+}
+
+static void test_28() // type switch: the first matching handler is called, one cache entry per dynamic type
+{
+  reset_cached_dynamic_cast_global_cache();
+
+  SimpleDerivedFromDerived derived_from_derived;
+  SimpleDerived derived;
+  OtherSimpleDerived other_derived;
+  SimpleBase base;
+
+  const auto classify = [](SimpleBase* const object)
+  {
+    return cached_type_switch(object,
+                              [object](SimpleDerivedFromDerived& result) { return (&result == dynamic_cast<SimpleDerivedFromDerived*>(object)) ? 1 : -1; },
+                              [object](SimpleDerived& result) { return (&result == dynamic_cast<SimpleDerived*>(object)) ? 2 : -1; },
+                              [object](OtherSimpleDerived& result) { return (&result == dynamic_cast<OtherSimpleDerived*>(object)) ? 3 : -1; });
+  };
+  static_assert(std::is_same_v<decltype(classify(nullptr)), std::optional<int>>);
+
+  for (int i = 0; i < 2; ++i) // the second round hits the cache
+  {
+    if (classify(&derived_from_derived) != 1 || classify(&derived) != 2 || classify(&other_derived) != 3)
+      THROW_TEST_FAILED();
+    if (classify(&base).has_value() || classify(nullptr).has_value())
+      THROW_TEST_FAILED();
+  }
+
+#if CACHED_DYNAMIC_CAST_STATISTICS > 0
+  const std::uint64_t misses_before = cached_dynamic_cast_stats().misses;
+  if (classify(&derived_from_derived) != 1 || classify(&base).has_value())
+    THROW_TEST_FAILED();
+  if (cached_dynamic_cast_stats().misses != misses_before)
+    THROW_TEST_FAILED();
+#endif
+
+  // handlers returning `void`, a const source, virtual bases
+  D d;
+  const A* const a = &d;
+  const C* c_result = nullptr;
+  if (!cached_type_switch(a, [&c_result](const C& c) { c_result = &c; }, [](const B&) { THROW_TEST_FAILED(); }))
+    THROW_TEST_FAILED();
+  if (c_result != dynamic_cast<const C*>(a))
+    THROW_TEST_FAILED();
+  const auto ignore_b = [](const B&) {};
+  static_assert(std::is_same_v<decltype(cached_type_switch(a, ignore_b)), bool>);
+  if (cached_type_switch(static_cast<const A*>(nullptr), ignore_b))
+    THROW_TEST_FAILED();
+
+  // an upcast in the first handler always applies, handlers of `final` classes only are checked by `typeid`
+  if (cached_type_switch(static_cast<SimpleBase*>(&other_derived), [](SimpleBase&) { return 'b'; }, [](OtherSimpleDerived&) { return 'o'; }) != 'b')
+    THROW_TEST_FAILED();
+  OtherSimpleDerivedFinal other_derived_final;
+  SimpleBase* const final_base = &other_derived_final;
+  if (cached_type_switch(final_base, [final_base](OtherSimpleDerivedFinal& result) { return &result == dynamic_cast<OtherSimpleDerivedFinal*>(final_base); }) != true)
+    THROW_TEST_FAILED();
+  if (cached_type_switch(static_cast<SimpleBase*>(&derived), [](OtherSimpleDerivedFinal&) { return true; }).has_value())
+    THROW_TEST_FAILED();
+
+  // through a separate domain
+  cast_cache domain;
+  for (int i = 0; i < 2; ++i)
+    if (cached_type_switch(domain, static_cast<SimpleBase*>(&derived), [](OtherSimpleDerived&) { return 3; }, [](SimpleDerived&) { return 2; }) != 2)
+      THROW_TEST_FAILED();
+  if (domain.usage().entry_count != 1)
+    THROW_TEST_FAILED();
+
+  reset_cached_dynamic_cast_global_cache();
+}
+
+static void test_29() // entries removed by the address of their types, e.g. those of a module about to be unloaded
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  // the destination type matches as well, the other entries stay
+  reset_cached_dynamic_cast_global_cache();
+  SimpleDerived derived;
+  SimpleBase* const base = &derived;
+  const cache_key derived_key{ &typeid(SimpleDerived), dynamic_type_key(base), &typeid(SimpleBase) };
+  const cache_key other_derived_key{ &typeid(OtherSimpleDerived), dynamic_type_key(base), &typeid(SimpleBase) };
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(default_cast_cache(), base), SimpleDerived);
+  ASSERT_NULL(cached_dynamic_cast<OtherSimpleDerived*>(default_cast_cache(), base));
+  if (erase_cached_dynamic_casts_in_address_range(&typeid(OtherSimpleDerived), &typeid(OtherSimpleDerived) + 1) != 1)
+    THROW_TEST_FAILED();
+  if (find_in_global_cache(other_derived_key) != missing_entry_offset || find_in_global_cache(derived_key) == missing_entry_offset)
+    THROW_TEST_FAILED();
+  ASSERT_NULL(cached_dynamic_cast<OtherSimpleDerived*>(base));
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(base), SimpleDerived);
+
+#if __has_include(<link.h>)
+  // every type of this test lives in the executable
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(default_cast_cache(), base), SimpleDerived);
+  if (erase_cached_dynamic_casts_of_module(reinterpret_cast<const void*>(&test_01)) == 0
+   || get_cached_dynamic_cast_global_cache_usage().entry_count != 0)
+    THROW_TEST_FAILED();
+#if CACHED_DYNAMIC_CAST_STATISTICS >= 2
+  if (!cached_dynamic_cast_stats().pairs.empty())
+    THROW_TEST_FAILED();
+#endif
+  ASSERT_NOT_NULL_AND_HAS_TYPEID_OF(cached_dynamic_cast<SimpleDerived*>(base), SimpleDerived);
+
+  // so were the classes it registered (see test_31), which are registered again, past their tombstones
+  if (find_registered_class(typeid(RegisteredRoot)) != nullptr || find_registered_class(typeid(RegisteredLeaf)) != nullptr)
+    THROW_TEST_FAILED();
+  static_cast<void>(cached_dynamic_cast_registered_class<RegisteredRoot>::register_at_startup());
+  static_cast<void>(cached_dynamic_cast_registered_class<RegisteredLeft>::register_at_startup());
+  static_cast<void>(cached_dynamic_cast_registered_class<RegisteredRight>::register_at_startup());
+  static_cast<void>(cached_dynamic_cast_registered_class<RegisteredBottom>::register_at_startup());
+  static_cast<void>(cached_dynamic_cast_registered_class<RegisteredLeaf>::register_at_startup());
+  static_cast<void>(cached_dynamic_cast_registered_class<RegisteredPartially>::register_at_startup());
+  if (find_registered_class(typeid(RegisteredLeaf)) == nullptr)
+    THROW_TEST_FAILED();
+#endif
+  if (erase_cached_dynamic_casts_of_module(nullptr) != 0)
+    THROW_TEST_FAILED();
+
+  reset_cached_dynamic_cast_global_cache();
+}
+
+static void test_30() // many entries removed piece by piece, the others kept
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  // the dynamic type keys point into `fake_vtables`, the first half of which is removed
+  static unsigned char fake_vtables[2048]; // several pieces per shard
+  const std::size_t half = sizeof(fake_vtables) / 2;
+  const auto fake_key = [](const std::size_t index)
+  {
+    return cache_key{ &typeid(SimpleDerived), &fake_vtables[index], &typeid(SimpleBase) };
+  };
+  std::vector<cache_entry> fake_entries;
+  for (std::size_t i = 0; i < sizeof(fake_vtables); ++i)
+    fake_entries.push_back(cache_entry{ fake_key(i), static_cast<offset_type>(i) });
+  cast_cache domain{ 0 };
+  domain.store_many(fake_entries.data(), fake_entries.size());
+  if (domain.erase_address_range(fake_vtables, fake_vtables + half) != half || domain.usage().entry_count != half)
+    THROW_TEST_FAILED();
+  for (std::size_t i = 0; i < sizeof(fake_vtables); ++i)
+    if (domain.find(fake_key(i)) != ((i < half) ? missing_entry_offset : static_cast<offset_type>(i)))
+      THROW_TEST_FAILED();
+}
+
+static void test_31() // registered hierarchies: neither `dynamic_cast` nor the table for the casts they can prove, even on the first call
+{
+  reset_cached_dynamic_cast_global_cache();
+#if CACHED_DYNAMIC_CAST_STATISTICS > 0
+  const std::uint64_t misses_before = cached_dynamic_cast_stats().misses;
+#endif
+
+  RegisteredBottom bottom;
+  RegisteredRight right;
+  RegisteredLeaf leaf;
+  RegisteredRoot* const bottom_root = &bottom;
+  RegisteredRoot* const right_root = &right;
+  RegisteredRoot* const leaf_root = &leaf;
+  const RegisteredLeft* const bottom_left = &bottom;
+
+  for (int i = 0; i < 2; ++i) // the second round hits the thread-local cache
+  {
+    if (cached_dynamic_cast<RegisteredLeft*>(bottom_root) != dynamic_cast<RegisteredLeft*>(bottom_root)
+     || cached_dynamic_cast<RegisteredRight*>(bottom_root) != dynamic_cast<RegisteredRight*>(bottom_root)
+     || cached_dynamic_cast<RegisteredBottom*>(bottom_root) != &bottom
+     || cached_dynamic_cast<const RegisteredRight*>(bottom_left) != static_cast<const RegisteredRight*>(&bottom))
+      THROW_TEST_FAILED();
+    ASSERT_HAS_TYPEID_OF(cached_dynamic_cast<RegisteredRight&>(*leaf_root), RegisteredLeaf);
+
+    // a registered leaf is treated like a `final` class
+    ASSERT_NULL(cached_dynamic_cast<RegisteredLeaf*>(bottom_root));
+    if (cached_dynamic_cast<RegisteredLeaf*>(leaf_root) != &leaf
+     || cached_dynamic_cast<const RegisteredLeaf*>(static_cast<const RegisteredRight*>(&leaf)) != &leaf)
+      THROW_TEST_FAILED();
+  }
+
+  if (get_cached_dynamic_cast_global_cache_usage().entry_count != 0)
+    THROW_TEST_FAILED();
+#if CACHED_DYNAMIC_CAST_STATISTICS > 0
+  if (cached_dynamic_cast_stats().misses != misses_before)
+    THROW_TEST_FAILED();
+#endif
+
+  // a destination missing from the ancestors of the dynamic type, impossible or reached through a base
+  // that was not listed, is left to `dynamic_cast`, once
+  RegisteredPartially partially;
+  RegisteredRight* const partially_right = &partially;
+  for (int i = 0; i < 2; ++i)
+  {
+    ASSERT_NULL(cached_dynamic_cast<RegisteredLeft*>(default_cast_cache(), right_root));
+    ASSERT_NULL(cached_dynamic_cast<RegisteredBottom*>(default_cast_cache(), right_root));
+    if (cached_dynamic_cast<RegisteredLeft*>(default_cast_cache(), partially_right) != static_cast<RegisteredLeft*>(&partially))
+      THROW_TEST_FAILED();
+  }
+  if (get_cached_dynamic_cast_global_cache_usage().entry_count != 3)
+    THROW_TEST_FAILED();
+#if CACHED_DYNAMIC_CAST_STATISTICS > 0
+  if (cached_dynamic_cast_stats().misses != misses_before + 3)
+    THROW_TEST_FAILED();
+#endif
+
+  // the usual path for a dynamic type or a destination that is not registered
+  UnregisteredBottom unregistered;
+  RegisteredRoot* const unregistered_root = &unregistered;
+  if (cached_dynamic_cast<RegisteredRight*>(default_cast_cache(), unregistered_root) != dynamic_cast<RegisteredRight*>(unregistered_root)
+   || cached_dynamic_cast<DummyOffsetModifyingStruct<48>*>(default_cast_cache(), bottom_root) != dynamic_cast<DummyOffsetModifyingStruct<48>*>(bottom_root))
+    THROW_TEST_FAILED();
+  if (get_cached_dynamic_cast_global_cache_usage().entry_count != 5)
+    THROW_TEST_FAILED();
+
+  reset_cached_dynamic_cast_global_cache();
+}
+
+static void test_32() // NUMA replicas: entries stored on one node are found on the others, resets and erasures reach them all
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  static unsigned char fake_vtables[4];
+  const auto fake_key = [](const std::size_t index)
+  {
+    return cache_key{ &typeid(SimpleDerived), &fake_vtables[index], &typeid(SimpleBase) };
+  };
+  const int original_node = numa_node_override;
+  cast_cache domain{ 0 };
+
+  numa_node_override = 0;
+  domain.store(fake_key(0), 8);
+  domain.store(fake_key(1), impossible_cast_offset);
+  numa_node_override = 1;
+  if (domain.find(fake_key(0)) != 8 || domain.find(fake_key(1)) != impossible_cast_offset)
+    THROW_TEST_FAILED();
+  domain.store(fake_key(2), 16);
+  numa_node_override = 0;
+  if (domain.find(fake_key(2)) != 16)
+    THROW_TEST_FAILED();
+
+  numa_node_override = 1;
+  if (domain.erase_address_range(&fake_vtables[0], &fake_vtables[1]) != 1)
+    THROW_TEST_FAILED();
+  domain.store(fake_key(3), 24);
+  numa_node_override = 0;
+  if (domain.find(fake_key(0)) != missing_entry_offset || domain.find(fake_key(3)) != 24)
+    THROW_TEST_FAILED();
+
+  domain.reset();
+  numa_node_override = 1;
+  if (domain.find(fake_key(2)) != missing_entry_offset || domain.find(fake_key(3)) != missing_entry_offset)
+    THROW_TEST_FAILED();
+  numa_node_override = original_node;
+}
+
+static void test_33() // intrusive rows: casts from an opted-in hierarchy skip the table, other dynamic types do not
+{
+  using detail::cached_dynamic_cast_detail::intrusive_rows_enabled; // otherwise, every cast goes through the table
+
+  reset_cached_dynamic_cast_global_cache();
+
+  IntrusiveBadge badge;
+  IntrusiveSquare square;
+  IntrusiveRing ring;
+  IntrusiveShape* const badge_shape = &badge;
+  IntrusiveShape* const square_shape = &square;
+  const IntrusiveSquare* const badge_square = &badge;
+
+  for (int i = 0; i < 2; ++i) // the first round fills the rows, the second one reads them
+  {
+    if (cached_dynamic_cast<IntrusiveCircle*>(badge_shape) != dynamic_cast<IntrusiveCircle*>(badge_shape)
+     || cached_dynamic_cast<IntrusiveSquare*>(badge_shape) != dynamic_cast<IntrusiveSquare*>(badge_shape)
+     || cached_dynamic_cast<IntrusiveBadge*>(badge_shape) != &badge
+     || cached_dynamic_cast<SimpleBase*>(badge_shape) != static_cast<SimpleBase*>(&badge)
+     || cached_dynamic_cast<const IntrusiveCircle*>(badge_square) != static_cast<const IntrusiveCircle*>(&badge)
+     || cached_dynamic_cast<IntrusiveSquare*>(square_shape) != &square)
+      THROW_TEST_FAILED();
+    ASSERT_NULL(cached_dynamic_cast<IntrusiveCircle*>(square_shape));
+    ASSERT_NULL(cached_dynamic_cast<IntrusiveBadge*>(square_shape));
+    ASSERT_HAS_TYPEID_OF(cached_dynamic_cast<IntrusiveCircle&>(*badge_shape), IntrusiveBadge);
+    ASSERT_THROWS_BAD_CAST(cached_dynamic_cast<IntrusiveCircle&>(*square_shape));
+    if (cached_dynamic_cast<IntrusiveSquare*>(default_cast_cache(), badge_shape) != dynamic_cast<IntrusiveSquare*>(badge_shape))
+      THROW_TEST_FAILED();
+  }
+  if (intrusive_rows_enabled && get_cached_dynamic_cast_global_cache_usage().entry_count != 0)
+    THROW_TEST_FAILED();
+
+  // the result depends on the subobject cast from, not only on the dynamic type
+  IntrusivePair pair;
+  IntrusiveLabel* const first_label = static_cast<IntrusiveFramed<0>*>(&pair);
+  IntrusiveLabel* const second_label = static_cast<IntrusiveFramed<1>*>(&pair);
+  for (int i = 0; i < 2; ++i)
+  {
+    if (cached_dynamic_cast<IntrusiveFrame*>(first_label) != static_cast<IntrusiveFramed<0>*>(&pair)
+     || cached_dynamic_cast<IntrusiveFrame*>(second_label) != static_cast<IntrusiveFramed<1>*>(&pair)
+     || cached_dynamic_cast<IntrusiveFramed<1>*>(first_label) != &pair
+     || cached_dynamic_cast<IntrusivePair*>(second_label) != &pair)
+      THROW_TEST_FAILED();
+  }
+  if (intrusive_rows_enabled && get_cached_dynamic_cast_global_cache_usage().entry_count != 0)
+    THROW_TEST_FAILED();
+
+  // a reset of the table leaves the rows alone
+  reset_cached_dynamic_cast_global_cache();
+  if (cached_dynamic_cast<IntrusiveSquare*>(badge_shape) != dynamic_cast<IntrusiveSquare*>(badge_shape))
+    THROW_TEST_FAILED();
+
+  // a dynamic type without a row of its own takes the usual path
+  IntrusiveShape* const ring_shape = &ring;
+  if (cached_dynamic_cast<IntrusiveCircle*>(ring_shape) != static_cast<IntrusiveCircle*>(&ring)
+   || cached_dynamic_cast<IntrusiveRing*>(ring_shape) != &ring)
+    THROW_TEST_FAILED();
+  ASSERT_NULL(cached_dynamic_cast<IntrusiveSquare*>(ring_shape));
+  if (intrusive_rows_enabled && get_cached_dynamic_cast_global_cache_usage().entry_count != 3)
+    THROW_TEST_FAILED();
+
+  reset_cached_dynamic_cast_global_cache();
+}
+
+static void test_34() // type matrix: rows grow by blocks of the columns in use, the dynamic keys get numbers; a new epoch reuses the cells, a bound stops the allocations
+{
+  using namespace detail::cached_dynamic_cast_detail;
+
+  static unsigned char fake_vtables[48];
+  type_matrix matrix;
+  if (matrix.find(&fake_vtables[0], 0, 1) != missing_entry_offset || matrix.bytes_used() != 0)
+    THROW_TEST_FAILED();
+
+  for (std::size_t key = 0; key < 40; ++key) // beyond the first table of numbers and directory of rows
+    for (std::size_t column = key % 3; column < 80; column += 3) // beyond the first size of a row
+      matrix.store(&fake_vtables[key], column, 1, (column % 2 == 0) ? static_cast<offset_type>(8 * key) : impossible_cast_offset);
+  for (std::size_t key = 0; key < 40; ++key)
+    for (std::size_t column = 0; column < 90; ++column)
+    {
+      const offset_type expected = (column >= 80 || column % 3 != key % 3) ? missing_entry_offset
+                                 : (column % 2 == 0) ? static_cast<offset_type>(8 * key) : impossible_cast_offset;
+      if (matrix.find(&fake_vtables[key], column, 1) != expected)
+        THROW_TEST_FAILED();
+    }
+  const std::size_t bytes_used = matrix.bytes_used();
+  if (bytes_used < 40 * 80 * sizeof(offset_type) / 3)
+    THROW_TEST_FAILED();
+
+  // a new epoch hides the cells of the old one, and stores into them without allocating
+  for (std::size_t key = 0; key < 20; ++key)
+    matrix.store(&fake_vtables[key], key % 3, 2, static_cast<offset_type>(16 * key));
+  for (std::size_t key = 0; key < 40; ++key)
+  {
+    if (matrix.find(&fake_vtables[key], key % 3, 2) != ((key < 20) ? static_cast<offset_type>(16 * key) : missing_entry_offset)
+     || matrix.find(&fake_vtables[key], key % 3 + 3, 2) != missing_entry_offset)
+      THROW_TEST_FAILED();
+  }
+  if (matrix.bytes_used() != bytes_used)
+    THROW_TEST_FAILED();
+
+  // a store for an earlier epoch, which raced with the change, never shows up in the later one
+  matrix.store(&fake_vtables[1], 1, 1, 8);
+  if (matrix.find(&fake_vtables[1], 1, 2) != missing_entry_offset)
+    THROW_TEST_FAILED();
+  matrix.store(&fake_vtables[1], 1, 2, 16);
+  if (matrix.find(&fake_vtables[1], 1, 2) != 16)
+    THROW_TEST_FAILED();
+
+  // a row only takes memory for the blocks of the columns stored into
+  matrix.store(&fake_vtables[39], 100'000, 2, 24);
+  if (matrix.find(&fake_vtables[39], 100'000, 2) != 24 || matrix.find(&fake_vtables[39], 99'999, 2) != missing_entry_offset
+   || matrix.bytes_used() - bytes_used > 100'000 * sizeof(std::uint64_t) / 4)
+    THROW_TEST_FAILED();
+
+  // a bounded matrix allocates no block beyond its size, the cells of the blocks it has keep being stored into
+  type_matrix bounded_matrix;
+  bounded_matrix.set_max_size(32); // two blocks
+  for (std::size_t key = 0; key < 5; ++key)
+    bounded_matrix.store(&fake_vtables[key], 0, 1, static_cast<offset_type>(8 * key));
+  const std::size_t bounded_bytes_used = bounded_matrix.bytes_used();
+  bounded_matrix.store(&fake_vtables[1], 15, 1, 40);
+  bounded_matrix.store(&fake_vtables[1], 16, 1, 48);
+  if (bounded_matrix.find(&fake_vtables[0], 0, 1) != 0 || bounded_matrix.find(&fake_vtables[1], 0, 1) != 8
+   || bounded_matrix.find(&fake_vtables[2], 0, 1) != missing_entry_offset || bounded_matrix.find(&fake_vtables[1], 15, 1) != 40
+   || bounded_matrix.find(&fake_vtables[1], 16, 1) != missing_entry_offset || bounded_matrix.bytes_used() != bounded_bytes_used)
+    THROW_TEST_FAILED();
+  bounded_matrix.set_max_size(48);
+  bounded_matrix.store(&fake_vtables[2], 0, 1, 16);
+  bounded_matrix.store(&fake_vtables[3], 0, 1, 24);
+  bounded_matrix.set_max_size(16); // what was allocated stays
+  bounded_matrix.store(&fake_vtables[2], 1, 1, 32);
+  bounded_matrix.store(&fake_vtables[3], 0, 1, 24);
+  if (bounded_matrix.find(&fake_vtables[2], 0, 1) != 16 || bounded_matrix.find(&fake_vtables[2], 1, 1) != 32
+   || bounded_matrix.find(&fake_vtables[3], 0, 1) != missing_entry_offset || bounded_matrix.find(&fake_vtables[1], 15, 1) != 40)
+    THROW_TEST_FAILED();
+  bounded_matrix.set_max_size(0);
+  bounded_matrix.store(&fake_vtables[3], 0, 1, 24);
+  if (bounded_matrix.find(&fake_vtables[3], 0, 1) != 24)
+    THROW_TEST_FAILED();
+
+  // the matrix of a domain keeps its memory across resets, and allocates within the capacity of the table
+  if constexpr (type_matrix_enabled)
+  {
+    cast_cache domain{ 0 };
+    const std::size_t table_bytes_used = domain.usage().bytes_used;
+    const auto fill = [&domain]
+    {
+      for (std::size_t key = 0; key < 40; ++key)
+        domain.store_in_matrix(&fake_vtables[key], key, domain.current_epoch(), static_cast<offset_type>(8 * key));
+    };
+    fill();
+    if (domain.usage().bytes_used <= table_bytes_used)
+      THROW_TEST_FAILED();
+    const epoch_type old_epoch = domain.current_epoch();
+    domain.reset();
+    const std::size_t reset_bytes_used = domain.usage().bytes_used;
+    if (domain.find_in_matrix(&fake_vtables[1], 1, domain.current_epoch()) != missing_entry_offset)
+      THROW_TEST_FAILED();
+    domain.store_in_matrix(&fake_vtables[1], 1, old_epoch, 8); // a cast that raced with the reset
+    if (domain.find_in_matrix(&fake_vtables[1], 1, domain.current_epoch()) != missing_entry_offset)
+      THROW_TEST_FAILED();
+    fill();
+    if (domain.usage().bytes_used != reset_bytes_used || domain.find_in_matrix(&fake_vtables[1], 1, domain.current_epoch()) != 8)
+      THROW_TEST_FAILED();
+    domain.set_capacity(20); // fewer cells than the 40 blocks already hold
+    domain.store_in_matrix(&fake_vtables[40], 0, domain.current_epoch(), 0);
+    if (domain.find_in_matrix(&fake_vtables[40], 0, domain.current_epoch()) != missing_entry_offset
+     || domain.find_in_matrix(&fake_vtables[39], 39, domain.current_epoch()) != 8 * 39)
+      THROW_TEST_FAILED();
+    domain.compact();
+    if (domain.find_in_matrix(&fake_vtables[39], 39, domain.current_epoch()) != 8 * 39)
+      THROW_TEST_FAILED();
+  }
+}
+
+template<int Index>
+static void test_35_check(const IntrusiveBranch<Index>& object)
+{
+  if (object.weight_during_construction != static_cast<const IntrusiveWeight*>(&object)
+   || cached_dynamic_cast<const IntrusiveWeight*>(static_cast<const IntrusiveNode*>(&object)) != static_cast<const IntrusiveWeight*>(&object))
+    THROW_TEST_FAILED();
+}
+
+static void test_35() // intrusive rows: casts from an object under construction as a base of a class with a virtual base
+{
+  using detail::cached_dynamic_cast_detail::intrusive_rows_enabled;
+
+  // the rows are never reset; the table is reset before each object, since with `type_info` keys (and no rows)
+  // it cannot tell an object under construction from a complete one either, see test_18
+  for (int i = 0; i < 2; ++i)
+  {
+    // the complete object first
+    reset_cached_dynamic_cast_global_cache();
+    test_35_check(IntrusiveBranch<0>{});
+    reset_cached_dynamic_cast_global_cache();
+    test_35_check(IntrusiveTree<0>{});
+
+    // the object under construction first, a complete one still gets a row of its own
+    reset_cached_dynamic_cast_global_cache();
+    test_35_check(IntrusiveTree<1>{});
+    reset_cached_dynamic_cast_global_cache();
+    test_35_check(IntrusiveBranch<1>{});
+    if (intrusive_rows_enabled && get_cached_dynamic_cast_global_cache_usage().entry_count != 0)
+      THROW_TEST_FAILED();
+  }
+  reset_cached_dynamic_cast_global_cache();
+}
+
+static void test_36() // statistics: a cast from a thread-local destructor that runs after the counts of its thread were moved to the totals
+{
+#if CACHED_DYNAMIC_CAST_STATISTICS >= 2
+  static std::atomic<bool> has_late_cast_succeeded;
+  has_late_cast_succeeded = false;
+  std::thread{ []
+  {
+    struct late_caster
+    {
+      ~late_caster()
+      {
+        SimpleDerived late_derived;
+        has_late_cast_succeeded = cached_dynamic_cast<SimpleDerived*>(static_cast<SimpleBase*>(&late_derived)) == &late_derived;
+      }
+    };
+    thread_local late_caster caster; // constructed before the statistics of the thread, so destroyed after them
+    static_cast<void>(&caster);
+    SimpleDerived derived;
+    static_cast<void>(cached_dynamic_cast<SimpleDerived*>(static_cast<SimpleBase*>(&derived)));
+  } }.join();
+  if (!has_late_cast_succeeded)
+    THROW_TEST_FAILED();
+#endif
+}
+
+#if defined(CACHED_DYNAMIC_CAST_TEST_PLUGIN)
+template<int Index>
+class RegisteredNeighbour : public SimpleBase
+{
+};
+
+template<int... Indices>
+static void test_37_register_neighbours(std::integer_sequence<int, Indices...>)
+{
+  using namespace detail::cached_dynamic_cast_detail;
+  (register_class(registered_class_data<RegisteredNeighbour<Indices>, type_list<RegisteredNeighbour<Indices>>>::info), ...);
+}
+#endif
+
+static void test_37() // registered classes of a module erased before it is unloaded, so that the registry never reads its memory again
+{
+#if defined(CACHED_DYNAMIC_CAST_TEST_PLUGIN)
+  using namespace detail::cached_dynamic_cast_detail;
+
+  void* const plugin = dlopen(CACHED_DYNAMIC_CAST_TEST_PLUGIN, RTLD_NOW | RTLD_LOCAL);
+  if (plugin == nullptr)
+    THROW_TEST_FAILED();
+  const auto plugin_type = reinterpret_cast<const std::type_info& (*)()>(dlsym(plugin, "cached_dynamic_cast_test_plugin_type"));
+  const auto plugin_casts = reinterpret_cast<bool (*)()>(dlsym(plugin, "cached_dynamic_cast_test_plugin_casts"));
+  if (plugin_type == nullptr || plugin_casts == nullptr)
+    THROW_TEST_FAILED();
+  if (!plugin_casts() || find_registered_class(plugin_type()) == nullptr)
+    THROW_TEST_FAILED();
+
+  const std::type_info& type = plugin_type();
+  static_cast<void>(erase_cached_dynamic_casts_of_module(reinterpret_cast<const void*>(plugin_casts)));
+  if (find_registered_class(type) != nullptr)
+    THROW_TEST_FAILED();
+  if (dlclose(plugin) != 0)
+    THROW_TEST_FAILED();
+
+  // enough classes for the registry to grow, which reads every class it moves, and lookups probing past
+  // the slots of the unloaded ones
+  test_37_register_neighbours(std::make_integer_sequence<int, 64>{});
+  if (find_registered_class(typeid(RegisteredNeighbour<63>)) == nullptr)
+    THROW_TEST_FAILED();
+  test_31();
+#endif
+}
+
 static int run_all_tests()
 {
   try
@@ -677,6 +2161,25 @@ static int run_all_tests()
     test_12();
     test_13();
     test_14();
+    test_15();
+    test_17();
+    test_18();
+    test_19();
+    test_20();
+    test_21();
+    test_22();
+    test_23();
+    test_24();
+    test_25();
+    test_26();
+    test_27();
+    test_28();
+    test_29();
+    test_31();
+    test_32();
+    test_33();
+    test_34();
+    test_35();
     return 0;
   }
   catch (const test_failed_exception& ex)
@@ -702,6 +2205,21 @@ int run_all_tests_multiple_times()
 
 int main()
 {
+#if CACHED_DYNAMIC_CAST_USDT_PROBES
+  STAP_PROBE(cached_dynamic_cast_tests, started);
+#endif
   static_tests();
+  try
+  {
+    test_16(); // runs only once, spawning threads would dominate the timing below
+    test_30(); // runs only once as well, filling the table would
+    test_36(); // spawns a thread too
+    test_37(); // loads and unloads a module, registering classes for good
+  }
+  catch (const test_failed_exception& ex)
+  {
+    std::cout << ex.what() << '\n';
+    return 1;
+  }
   return run_all_tests_multiple_times();
 }